@@ -0,0 +1,87 @@
+/*
+* Copyright 2016 Google Inc. All Rights Reserved.
+
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+
+* http://www.apache.org/licenses/LICENSE-2.0
+
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include <cstring>
+#include <gtest/gtest.h>
+#include <type/external.h>
+#include <type/serialize.h>
+
+TEST(ExternalTypeTest, Constructor) {
+	float data[] = { 1, 2, 3 };
+	type::t_external_array<float> array(data, 3);
+	ASSERT_EQ(3u, array.size());
+	auto read_array(type::read(array));
+	// Read in place.
+	ASSERT_EQ(data, read_array.data());
+	ASSERT_EQ(2, read_array[1]);
+	ASSERT_TRUE(std::equal(read_array.begin(), read_array.end(), data));
+}
+
+TEST(ExternalTypeTest, Write) {
+	std::vector<float> data(100, 0.f);
+	type::t_external_array<float> array(data.data(), data.size());
+	type::write(array)[50] = 5;
+	ASSERT_EQ(5, data[50]);
+	ASSERT_EQ(2u, type::internal::get_revision(array).load());
+}
+
+TEST(ExternalTypeTest, Owner) {
+	std::shared_ptr<std::vector<glm::vec4>> data(
+		std::make_shared<std::vector<glm::vec4>>(10, glm::vec4(1)));
+	type::t_external_array<glm::vec4> array(data->data(), data->size(), data);
+	std::weak_ptr<std::vector<glm::vec4>> weak(data);
+	data.reset();
+	ASSERT_FALSE(weak.expired());
+	ASSERT_EQ(glm::vec4(1), type::read(array)[9]);
+}
+
+TEST(ExternalTypeTest, Serialize) {
+	// Such as vertices in a memory mapped file.
+	std::vector<glm::vec4> data(1000);
+	for (std::size_t i = 0; i < data.size(); ++i) {
+		data[i] = glm::vec4(float(i), 1, 2, 3);
+	}
+	type::t_external_array<glm::vec4> array(data.data(), data.size());
+	auto serialized(type::make_serialize<type::linear_std140>(
+		type::make_supplier(std::ref(array))));
+	ASSERT_EQ(data.size() * sizeof(glm::vec4), type::size(serialized));
+	std::vector<uint8_t> output(type::size(serialized));
+	std::vector<type::byte_range_type> ranges;
+	type::flush(serialized, output.data(), ranges);
+	ASSERT_EQ(0, std::memcmp(data.data(), output.data(), output.size()));
+	ASSERT_EQ(1u, ranges.size());
+
+	ranges.clear();
+	ASSERT_FALSE(type::dirty(serialized));
+	type::write(array)[500] = glm::vec4(-1);
+	ASSERT_TRUE(type::dirty(serialized));
+	type::flush(serialized, output.data(), ranges);
+	ASSERT_EQ(1u, ranges.size());
+	ASSERT_LT(ranges[0].size, output.size());
+	ASSERT_EQ(0, std::memcmp(data.data(), output.data(), output.size()));
+}
+
+TEST(ExternalTypeTest, ReadOnly) {
+	// Such as a file mapped without write access.
+	const std::vector<glm::vec4> data(100, glm::vec4(1, 2, 3, 4));
+	type::t_external_array<const glm::vec4> array(data.data(), data.size());
+	auto serialized(type::make_serialize<type::linear_std140>(
+		type::make_supplier(std::ref(array))));
+	std::vector<uint8_t> output(type::size(serialized));
+	type::flush(serialized, output.data());
+	ASSERT_EQ(0, std::memcmp(data.data(), output.data(), output.size()));
+	ASSERT_FALSE(type::dirty(serialized));
+	ASSERT_EQ(data.data(), type::read(array).data());
+}
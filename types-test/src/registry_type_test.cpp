@@ -0,0 +1,145 @@
+/*
+* Copyright 2016 Google Inc. All Rights Reserved.
+
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+
+* http://www.apache.org/licenses/LICENSE-2.0
+
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include <thread>
+#include <gtest/gtest.h>
+#include <type/serialize.h>
+#include <type/snapshot.h>
+#include <type/transform.h>
+
+TEST(RegistryTypeTest, Unsubscribed) {
+	type::internal::get_registry().collect();
+	type::t_array<float> array(10, 0.f);
+	type::write(array)[0] = 1;
+	ASSERT_EQ(0u, type::internal::get_registry().collect());
+}
+
+TEST(RegistryTypeTest, QueuedOnce) {
+	type::t_array<float> array1(10, 0.f), array2(10, 0.f);
+	auto serialized1(type::make_serialize<type::linear>(type::make_supplier(std::ref(array1))));
+	auto serialized2(type::make_serialize<type::linear>(
+		type::make_supplier(std::ref(array1)), type::make_supplier(std::ref(array2))));
+	float output1[10], output2[20];
+	type::flush(serialized1, output1);
+	type::flush(serialized2, output2);
+	type::internal::get_registry().collect();
+	ASSERT_FALSE(type::dirty(serialized1));
+	ASSERT_FALSE(type::dirty(serialized2));
+
+	for (int i = 0; i < 10; ++i) {
+		type::write(array1)[i] = float(i);
+	}
+	// Both serializes read array1, which is collected once.
+	ASSERT_EQ(1u, type::internal::get_registry().collect());
+	ASSERT_TRUE(type::dirty(serialized1));
+	ASSERT_TRUE(type::dirty(serialized2));
+	type::flush(serialized1, output1);
+	ASSERT_FALSE(type::dirty(serialized1));
+	ASSERT_TRUE(type::dirty(serialized2));
+	type::flush(serialized2, output2);
+	ASSERT_FALSE(type::dirty(serialized2));
+	ASSERT_EQ(9.f, output1[9]);
+	ASSERT_EQ(9.f, output2[9]);
+
+	type::write(array2)[0] = 1;
+	ASSERT_FALSE(type::dirty(serialized1));
+	ASSERT_TRUE(type::dirty(serialized2));
+}
+
+TEST(RegistryTypeTest, CollectBatch) {
+	type::t_array<float> array(10, 0.f);
+	auto serialized(type::make_serialize<type::linear>(type::make_supplier(std::ref(array))));
+	float output[10];
+	type::flush(serialized, output);
+	type::write(array)[0] = 1;
+	{
+		// Collected once up front, dirty does not collect within the batch.
+		type::internal::collect_batch_type batch;
+		ASSERT_TRUE(type::dirty(serialized));
+		type::flush(serialized, output);
+		type::write(array)[1] = 2;
+		{
+			type::internal::collect_batch_type nested;
+			ASSERT_FALSE(type::dirty(serialized));
+		}
+		ASSERT_FALSE(type::dirty(serialized));
+	}
+	ASSERT_TRUE(type::dirty(serialized));
+	type::flush(serialized, output);
+	ASSERT_EQ(2.f, output[1]);
+}
+
+TEST(RegistryTypeTest, Snapshot) {
+	type::t_snapshot_array<float> array(10, 0.f);
+	auto serialized(type::make_serialize<type::linear>(type::make_supplier(std::ref(array))));
+	float output[10];
+	type::flush(serialized, output);
+	ASSERT_FALSE(type::dirty(serialized));
+	type::write(array)[3] = 3;
+	ASSERT_TRUE(type::dirty(serialized));
+	type::flush(serialized, output);
+	ASSERT_EQ(3.f, output[3]);
+}
+
+TEST(RegistryTypeTest, Polled) {
+	type::t_array<float> input({ 1, 2, 3 });
+	auto transform(type::make_transform(type::t_array<float>(3),
+		[](const type::readable_t_array<float, true> &input, type::writable_t_array<float> &&output) {
+		std::transform(input.begin(), input.end(), output.begin(),
+			[](float value) { return value * 2; });
+	}, std::ref(input)));
+	auto serialized(type::make_serialize<type::linear>(type::make_supplier(std::ref(transform))));
+	float output[3];
+	type::flush(serialized, output);
+	ASSERT_FALSE(type::dirty(serialized));
+	type::write(input)[1] = 4;
+	ASSERT_TRUE(type::dirty(serialized));
+	type::flush(serialized, output);
+	ASSERT_EQ(8.f, output[1]);
+}
+
+TEST(RegistryTypeTest, ConcurrentWriters) {
+	std::vector<std::unique_ptr<type::t_array<float>>> arrays;
+	for (int i = 0; i < 4; ++i) {
+		arrays.emplace_back(new type::t_array<float>(64, 0.f));
+	}
+	auto serialized(type::make_serialize<type::linear>(
+		type::make_supplier(std::ref(*arrays[0])), type::make_supplier(std::ref(*arrays[1])),
+		type::make_supplier(std::ref(*arrays[2])), type::make_supplier(std::ref(*arrays[3]))));
+	std::vector<float> output(4 * 64);
+	type::flush(serialized, output.data());
+
+	std::vector<std::thread> writers;
+	for (int i = 0; i < 4; ++i) {
+		writers.push_back(std::thread([&arrays, i]() {
+			for (int j = 1; j <= 1000; ++j) {
+				type::write(*arrays[i])[j % 64] = float(j);
+			}
+		}));
+	}
+	for (int i = 0; i < 100; ++i) {
+		if (type::dirty(serialized)) {
+			type::flush(serialized, output.data());
+		}
+	}
+	for (std::thread &writer : writers) {
+		writer.join();
+	}
+	type::flush(serialized, output.data());
+	ASSERT_FALSE(type::dirty(serialized));
+	for (int i = 0; i < 4; ++i) {
+		ASSERT_EQ(1000.f, output[i * 64 + 1000 % 64]);
+	}
+}
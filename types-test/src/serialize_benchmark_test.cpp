@@ -0,0 +1,182 @@
+/*
+* Copyright 2016 Google Inc. All Rights Reserved.
+
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+
+* http://www.apache.org/licenses/LICENSE-2.0
+
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include <atomic>
+#include <future>
+#include <thread>
+#include <gtest/gtest.h>
+#include <type/serialize.h>
+#include <type/snapshot.h>
+#include "thread_pool.h"
+
+namespace {
+
+const std::size_t elements = 1 << 16;
+
+// Checks that the compile-time plan for T in Layout writes the same bytes
+// as the per-element copy.
+template<type::memory_layout Layout, typename T>
+void compare() {
+	typedef type::internal::primitive_type_information<Layout, T> information;
+	typedef type::internal::copy_plan_type<Layout, T, false> element_plan;
+	typedef type::internal::copy_plan_type<Layout, T> plan;
+	const std::size_t stride(information::array_size);
+	std::vector<T> values(elements);
+	for (std::size_t i = 0; i < elements; ++i) {
+		std::memset(&values[i], int(i), sizeof(T));
+	}
+	std::vector<uint8_t> expected(elements * stride), output(elements * stride);
+	element_plan::copy(values, 0, elements, stride, expected.data());
+	plan::copy(values, 0, elements, stride, output.data());
+	for (std::size_t i = 0; i < elements; ++i) {
+		ASSERT_EQ(0, std::memcmp(&expected[i * stride], &output[i * stride],
+			information::size));
+	}
+}
+
+// A writer thread updates storage while an uploader thread flushes it,
+// the last flush writes what was written last.
+template<typename Storage>
+void contention() {
+	const std::size_t count(1 << 18), window(1 << 12), writes(1000);
+	Storage storage(count, glm::vec4(0));
+	auto serialized(type::make_serialize<type::linear_std140>(
+		type::make_supplier(std::ref(storage))));
+	std::vector<uint8_t> output(type::size(serialized));
+	std::atomic<bool> writing(true);
+	std::thread uploader([&]() {
+		while (writing) {
+			type::flush(serialized, output.data());
+			std::this_thread::yield();
+		}
+	});
+	for (std::size_t i = 0; i < writes; ++i) {
+		auto write_storage(type::write(storage));
+		const std::size_t first(i * window % count);
+		for (std::size_t j = first; j < first + window; ++j) {
+			write_storage[j] = glm::vec4(float(i));
+		}
+	}
+	writing = false;
+	uploader.join();
+	type::flush(serialized, output.data());
+	auto read_storage(type::read(storage));
+	ASSERT_EQ(0, std::memcmp(&read_storage[0], output.data(), output.size()));
+}
+
+}  // anonymous namespace
+
+TEST(SerializeBenchmarkTest, Bitwise) {
+	ASSERT_TRUE((type::internal::is_bitwise<type::linear, float>::value));
+	ASSERT_TRUE((type::internal::is_bitwise<type::linear_std140, glm::vec4>::value));
+	ASSERT_TRUE((type::internal::is_bitwise<type::linear_std430, glm::mat4>::value));
+	ASSERT_FALSE((type::internal::is_bitwise<type::linear_std140, glm::mat3>::value));
+	ASSERT_FALSE((type::internal::is_bitwise<type::linear_std140, std::array<float, 2>>::value));
+	ASSERT_TRUE((type::internal::is_bitwise<type::linear_std430, std::array<float, 2>>::value));
+	ASSERT_FALSE((type::internal::is_bitwise<type::linear, std::tuple<float, float>>::value));
+}
+
+TEST(SerializeBenchmarkTest, LinearFloat) {
+	compare<type::linear, float>();
+}
+
+TEST(SerializeBenchmarkTest, LinearVec4) {
+	compare<type::linear_std140, glm::vec4>();
+}
+
+TEST(SerializeBenchmarkTest, StridedVec3) {
+	compare<type::linear_std430, glm::vec3>();
+}
+
+TEST(SerializeBenchmarkTest, PaddedMat3) {
+	compare<type::linear_std140, glm::mat3>();
+}
+
+TEST(SerializeBenchmarkTest, LinearMat4) {
+	compare<type::linear_std430, glm::mat4>();
+}
+
+TEST(SerializeBenchmarkTest, ParallelScaling) {
+	const std::size_t count(1 << 20);
+	type::t_array<glm::vec4> positions(count, glm::vec4(1, 2, 3, 4));
+	type::t_array<glm::vec3> normals(count, glm::vec3(0, 0, 1));
+	const auto serialize([&]() {
+		return type::make_serialize<type::linear_std140>(
+			type::make_supplier(std::ref(positions)), type::make_supplier(std::ref(normals)));
+	});
+	std::vector<uint8_t> expected(type::size(serialize()));
+	type::flush(serialize(), expected.data());
+
+	const std::size_t max_threads(std::max(std::thread::hardware_concurrency(), 2u));
+	for (std::size_t threads = 1; threads <= max_threads; threads *= 2) {
+		test::thread_pool_type pool(threads);
+		const type::executor_type executor(std::ref(pool));
+		std::vector<uint8_t> output(expected.size());
+		std::vector<type::byte_range_type> ranges;
+		// A new serialize_type flushes everything.
+		type::flush(serialize(), output.data(), ranges, executor);
+		ASSERT_EQ(expected, output);
+	}
+}
+
+TEST(SerializeBenchmarkTest, WriterUploaderContention) {
+	contention<type::t_array<glm::vec4>>();
+	contention<type::t_snapshot_array<glm::vec4>>();
+}
+
+TEST(SerializeBenchmarkTest, WriterDuringUpload) {
+	const std::size_t count(1 << 12), writes(100);
+	type::t_snapshot_array<glm::vec4> storage(count, glm::vec4(0));
+	auto serialized(type::make_serialize<type::linear_std140>(
+		type::make_supplier(std::ref(storage))));
+	std::vector<glm::vec4> output(count, glm::vec4(-1));
+	std::promise<void> written;
+	const std::shared_future<void> done(written.get_future());
+	std::thread writer;
+	std::vector<std::thread> uploaders;
+	// The copies of the upload only run once the writer is done. The storage
+	// was read before the first copy is handed over, so with a storage_type
+	// the writer would wait for the upload and the upload for the writer.
+	const type::executor_type executor([&](std::function<void()> task) {
+		if (!writer.joinable()) {
+			writer = std::thread([&]() {
+				for (std::size_t i = 0; i < writes; ++i) {
+					type::write(storage)[i] = glm::vec4(float(i + 1));
+				}
+				written.set_value();
+			});
+		}
+		uploaders.emplace_back([done, task]() {
+			done.wait();
+			task();
+		});
+	});
+	std::vector<type::byte_range_type> ranges;
+	type::flush(serialized, output.data(), ranges, executor, count * sizeof(glm::vec4) / 4);
+	writer.join();
+	for (std::thread &uploader : uploaders) {
+		uploader.join();
+	}
+	// The upload is of the revision before the writes.
+	ASSERT_EQ(4u, uploaders.size());
+	for (const glm::vec4 &value : output) {
+		ASSERT_EQ(glm::vec4(0), value);
+	}
+	ASSERT_TRUE(type::dirty(serialized));
+	type::flush(serialized, output.data());
+	for (std::size_t i = 0; i < writes; ++i) {
+		ASSERT_EQ(glm::vec4(float(i + 1)), output[i]);
+	}
+}
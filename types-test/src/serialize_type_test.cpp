@@ -13,6 +13,8 @@
 * See the License for the specific language governing permissions and
 * limitations under the License.
 */
+#include <stdexcept>
+#include <thread>
 #include <gtest/gtest.h>
 #include <type/serialize.h>
 
@@ -491,3 +493,161 @@ TEST(SerializeTypeTest, GroupedInterleavedStd140ArrayLayout1) {
 	ASSERT_TRUE(std::equal(&output[0] + 40, &output[0] + 43, compare9));
 	ASSERT_TRUE(std::equal(&output[0] + 44, &output[0] + 47, compare10));
 }
+
+TEST(SerializeTypeTest, IncrementalFlush) {
+	type::t_array<float> array1(100, 1.f);
+	type::t_array<float> array2({ 1, 2, 3 });
+	type::serialize_type serialized(type::make_serialize<type::linear>(
+		type::make_supplier(std::ref(array1)), type::make_supplier(std::ref(array2))));
+	float output[103];
+	std::vector<type::byte_range_type> ranges;
+	type::flush(serialized, output, ranges);
+	ASSERT_EQ(1u, ranges.size());
+	ASSERT_EQ(0u, ranges[0].offset);
+	ASSERT_EQ(sizeof(output), ranges[0].size);
+
+	ranges.clear();
+	type::flush(serialized, output, ranges);
+	ASSERT_TRUE(ranges.empty());
+
+	type::write(array1)[40] = 5;
+	type::flush(serialized, output, ranges);
+	ASSERT_EQ(1u, ranges.size());
+	ASSERT_LE(ranges[0].offset, 40 * sizeof(float));
+	ASSERT_GE(ranges[0].offset + ranges[0].size, 41 * sizeof(float));
+	ASSERT_LT(ranges[0].size, 100 * sizeof(float));
+	ASSERT_EQ(5, output[40]);
+	ASSERT_EQ(1, output[39]);
+	ASSERT_EQ(2, output[101]);
+
+	ranges.clear();
+	{
+		auto writer(type::write(array2));
+		std::fill(writer.begin(), writer.end(), 7.f);
+	}
+	type::flush(serialized, output, ranges);
+	ASSERT_EQ(1u, ranges.size());
+	ASSERT_EQ(100 * sizeof(float), ranges[0].offset);
+	ASSERT_EQ(3 * sizeof(float), ranges[0].size);
+	ASSERT_EQ(7, output[100]);
+	ASSERT_EQ(7, output[102]);
+	ASSERT_EQ(5, output[40]);
+}
+
+TEST(SerializeTypeTest, PaddedVec3Mat3) {
+	type::t_array<glm::vec3> array1{ { 1, 2, 3 }, { 4, 5, 6 }, { 7, 8, 9 }, { 10, 11, 12 } };
+	type::t_array<glm::mat3> array2{ { 13, 14, 15, 16, 17, 18, 19, 20, 21 },
+		{ 22, 23, 24, 25, 26, 27, 28, 29, 30 } };
+	auto serialized(type::make_serialize<type::linear_std140>(
+		type::make_supplier(std::ref(array1)),
+		type::make_supplier(std::ref(array2))));
+	const std::size_t size(4 * 4 + 2 * 3 * 4);
+	ASSERT_EQ(type::size(serialized), sizeof(float) * size);
+	float output[size];
+	type::flush(serialized, output);
+	float value(1);
+	for (std::size_t column = 0; column < 4 + 2 * 3; ++column) {
+		for (std::size_t i = 0; i < 3; ++i) {
+			ASSERT_EQ(value++, output[column * 4 + i]);
+		}
+	}
+}
+
+TEST(SerializeTypeTest, ParallelFlush) {
+	type::t_array<glm::vec4> array1(1000, glm::vec4(1, 2, 3, 4));
+	type::t_array<glm::vec3> array2(500, glm::vec3(5, 6, 7));
+	auto serialized(type::make_serialize<type::linear_std140>(
+		type::make_supplier(std::ref(array1)),
+		type::make_supplier(std::ref(array2))));
+	std::vector<uint8_t> expected(type::size(serialized)), output(expected.size());
+	type::flush(serialized, expected.data());
+
+	std::vector<std::thread> threads;
+	const type::executor_type executor([&](std::function<void()> task) {
+		threads.push_back(std::thread(std::move(task)));
+	});
+	auto parallel_serialized(type::make_serialize<type::linear_std140>(
+		type::make_supplier(std::ref(array1)),
+		type::make_supplier(std::ref(array2))));
+	std::vector<type::byte_range_type> ranges;
+	type::flush(parallel_serialized, output.data(), ranges, executor, 1024);
+	for (std::thread &thread : threads) {
+		thread.join();
+	}
+	ASSERT_GT(threads.size(), 1u);
+	ASSERT_EQ(expected, output);
+	ASSERT_EQ(1u, ranges.size());
+	ASSERT_EQ(0u, ranges.front().offset);
+	ASSERT_EQ(output.size(), ranges.front().size);
+
+	type::write(array2)[100] = glm::vec3(8, 9, 10);
+	threads.clear();
+	ranges.clear();
+	type::flush(parallel_serialized, output.data(), ranges, executor, 1024);
+	ASSERT_TRUE(threads.empty());
+	ASSERT_EQ(glm::vec3(8, 9, 10),
+		*reinterpret_cast<glm::vec3 *>(&output[1000 * 16 + 100 * 16]));
+}
+
+TEST(SerializeTypeTest, ParallelFlushThrows) {
+	type::t_array<glm::vec4> array(1000, glm::vec4(1, 2, 3, 4));
+	auto serialized(type::make_serialize<type::linear_std140>(
+		type::make_supplier(std::ref(array))));
+	std::vector<uint8_t> expected(type::size(serialized)), output(expected.size());
+	type::flush(serialized, expected.data());
+	auto parallel_serialized(type::make_serialize<type::linear_std140>(
+		type::make_supplier(std::ref(array))));
+	std::vector<type::byte_range_type> ranges;
+
+	// The executor fails after running the first task on a thread.
+	std::vector<std::thread> threads;
+	const type::executor_type failing_executor([&](std::function<void()> task) {
+		if (!threads.empty()) {
+			throw std::runtime_error("executor");
+		}
+		threads.push_back(std::thread(std::move(task)));
+	});
+	ASSERT_THROW(type::flush(parallel_serialized, output.data(), ranges, failing_executor,
+		1024), std::runtime_error);
+	for (std::thread &thread : threads) {
+		thread.join();
+	}
+	ASSERT_TRUE(type::dirty(parallel_serialized));
+
+	// Everything is written again, not only what changed since the failure.
+	const type::executor_type executor([](std::function<void()> task) {
+		task();
+	});
+	ranges.clear();
+	type::flush(parallel_serialized, output.data(), ranges, executor, 1024);
+	ASSERT_EQ(expected, output);
+}
+
+TEST(SerializeTypeTest, DirtyWhileWriting) {
+	static_assert(sizeof(type::revision_type) == 8, "revisions are 64 bit");
+	type::t_array<float> array(64, 0.f);
+	auto serialized(type::make_serialize<type::linear>(type::make_supplier(std::ref(array))));
+	float output[64];
+	type::flush(serialized, output);
+	ASSERT_FALSE(type::dirty(serialized));
+
+	// dirty is checked without a lock while the writer holds the storage.
+	std::thread writer([&]() {
+		for (int i = 1; i <= 1000; ++i) {
+			type::write(array)[i % 64] = float(i);
+		}
+	});
+	while (!type::dirty(serialized)) {
+		std::this_thread::yield();
+	}
+	for (int i = 0; i < 100; ++i) {
+		if (type::dirty(serialized)) {
+			type::flush(serialized, output);
+		}
+	}
+	writer.join();
+	type::flush(serialized, output);
+	ASSERT_FALSE(type::dirty(serialized));
+	ASSERT_EQ(1000.f, output[1000 % 64]);
+	ASSERT_EQ(999.f, output[999 % 64]);
+}
@@ -0,0 +1,129 @@
+/*
+* Copyright 2016 Google Inc. All Rights Reserved.
+
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+
+* http://www.apache.org/licenses/LICENSE-2.0
+
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include <gtest/gtest.h>
+#include <type/serialize.h>
+#include <type/snapshot.h>
+
+TEST(SnapshotTypeTest, Constructor) {
+	type::t_snapshot_array<float> array({ 1, 2, 3 });
+	ASSERT_EQ(3u, array.size());
+	auto read_array(type::read(array));
+	ASSERT_EQ(3u, read_array.size());
+	ASSERT_TRUE(std::equal(read_array.begin(), read_array.end(),
+		std::vector<float>({ 1, 2, 3 }).begin()));
+}
+
+TEST(SnapshotTypeTest, ReaderKeepsSnapshot) {
+	type::t_snapshot_array<float> array(100, 0.f);
+	auto before(type::read(array));
+	{
+		// Would deadlock with a storage_type, the reader holds no lock.
+		auto write_array(type::write(array));
+		write_array[5] = 1;
+	}
+	ASSERT_EQ(0, before[5]);
+	ASSERT_EQ(1, type::read(array)[5]);
+	ASSERT_EQ(2u, type::internal::get_revision(array).load());
+}
+
+TEST(SnapshotTypeTest, Recycle) {
+	type::t_snapshot_array<float> array(100, 0.f);
+	for (std::size_t i = 0; i < 10; ++i) {
+		auto write_array(type::write(array));
+		write_array[i * 10] = float(i + 1);
+	}
+	{
+		auto held(type::read(array));
+		type::write(array)[99] = 100;
+	}
+	type::write(array)[98] = 99;
+	auto read_array(type::read(array));
+	for (std::size_t i = 0; i < 10; ++i) {
+		ASSERT_EQ(float(i + 1), read_array[i * 10]);
+	}
+	ASSERT_EQ(99, read_array[98]);
+	ASSERT_EQ(100, read_array[99]);
+}
+
+TEST(SnapshotTypeTest, Serialize) {
+	type::t_snapshot_array<float> array(100, 0.f);
+	auto serialized(type::make_serialize<type::linear>(
+		type::make_supplier(std::ref(array))));
+	std::vector<float> output(array.size());
+	type::flush(serialized, output.data());
+	ASSERT_FALSE(type::dirty(serialized));
+
+	type::write(array)[70] = 1;
+	ASSERT_TRUE(type::dirty(serialized));
+	std::vector<type::byte_range_type> ranges;
+	type::flush(serialized, output.data(), ranges);
+	ASSERT_EQ(1, output[70]);
+	ASSERT_EQ(1u, ranges.size());
+	ASSERT_EQ(64 * sizeof(float), ranges.front().offset);
+	ASSERT_EQ(32 * sizeof(float), ranges.front().size);
+}
+
+namespace {
+
+// Counts the elements copied by a storage.
+struct counted_type {
+	static std::size_t copies;
+
+	counted_type() = default;
+	counted_type(const counted_type &copy) : value(copy.value) {
+		++copies;
+	}
+
+	counted_type &operator=(const counted_type &copy) {
+		value = copy.value;
+		++copies;
+		return *this;
+	}
+
+	int value = 0;
+};
+
+std::size_t counted_type::copies = 0;
+
+}  // anonymous namespace
+
+TEST(SnapshotTypeTest, PublishCopiesWrittenChunks) {
+	const std::size_t count(1 << 12), writes(100);
+	type::t_snapshot_array<counted_type> array(count);
+	// A reader holding a snapshot all along, such as a long upload.
+	auto held(type::read(array));
+	std::vector<type::readable_snapshot_type<counted_type>> readers;
+	counted_type::copies = 0;
+	for (std::size_t i = 0; i < writes; ++i) {
+		type::write(array)[i * 7 % count].value = int(i + 1);
+		// Bursts of readers holding the snapshots of a few writes at once.
+		if (i % 10 < 3) {
+			readers.push_back(type::read(array));
+		} else {
+			readers.clear();
+		}
+	}
+	// Six copies at most: held, three readers, front and back. Four are made
+	// after the constructor, then each written chunk is caught up by each copy
+	// at most once.
+	ASSERT_LE(counted_type::copies, 4 * count + 6 * writes
+		* type::internal::dirty_type::chunk_size);
+	auto read_array(type::read(array));
+	for (std::size_t i = 0; i < writes; ++i) {
+		ASSERT_EQ(int(i + 1), read_array[i * 7 % count].value);
+	}
+	ASSERT_EQ(0, held[7].value);
+}
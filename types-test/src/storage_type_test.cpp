@@ -13,6 +13,8 @@
 * See the License for the specific language governing permissions and
 * limitations under the License.
 */
+#include <atomic>
+#include <future>
 #include <gtest/gtest.h>
 #include <type/storage.h>
 #include <numeric>
@@ -93,6 +95,35 @@ TEST(ArrayTypeTest, MutateMove) {
 	ASSERT_EQ(2, type::read(array)[0]);
 }
 
+TEST(ArrayTypeTest, ConcurrentReaders) {
+	type::t_array<float> array({ 1, 2, 3 });
+	auto read_array(type::read(array));
+	// Another reader proceeds while one holds the storage, a writer does not.
+	ASSERT_TRUE(std::async(std::launch::async, [&]() {
+		auto concurrent_read(type::read(array, std::try_to_lock));
+		return concurrent_read[1] == 2;
+	}).get());
+	ASSERT_FALSE(std::async(std::launch::async, [&]() {
+		return type::internal::get_lock(array).try_lock();
+	}).get());
+	// The writer signals once it is about to take the lock. It cannot have
+	// written while the reader holds the storage, whenever it got there.
+	std::promise<void> started;
+	std::atomic<bool> written(false);
+	std::future<float> writer(std::async(std::launch::async, [&]() {
+		started.set_value();
+		type::write(array)[1] = 4;
+		written = true;
+		return type::read(array)[1];
+	}));
+	started.get_future().wait();
+	ASSERT_FALSE(written);
+	ASSERT_EQ(2, read_array[1]);
+	read_array = type::readable_t_array<float, true>();
+	ASSERT_EQ(4, writer.get());
+	ASSERT_TRUE(written);
+}
+
 TEST(PrimitiveTypeTest, Construct) {
 	type::t_primitive<float> primitive1(1.f);
 	type::t_primitive<float> primitive2;
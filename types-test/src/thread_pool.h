@@ -0,0 +1,84 @@
+/*
+* Copyright 2016 Google Inc. All Rights Reserved.
+
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+
+* http://www.apache.org/licenses/LICENSE-2.0
+
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace test {
+
+// Fixed size pool shared by the tests, an executor is any callable taking
+// the task.
+class thread_pool_type {
+public:
+	explicit thread_pool_type(std::size_t count) : running(true) {
+		for (std::size_t i = 0; i < count; ++i) {
+			threads.push_back(std::thread([this]() {
+				for (;;) {
+					std::function<void()> task;
+					{
+						std::unique_lock<std::mutex> lock(mutex);
+						available.wait(lock, [this]() { return !tasks.empty() || !running; });
+						if (tasks.empty()) {
+							return;
+						}
+						task = std::move(tasks.front());
+						tasks.pop();
+					}
+					task();
+				}
+			}));
+		}
+	}
+
+	thread_pool_type(const thread_pool_type &) = delete;
+	thread_pool_type &operator=(const thread_pool_type &) = delete;
+
+	~thread_pool_type() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			running = false;
+		}
+		available.notify_all();
+		for (std::thread &thread : threads) {
+			thread.join();
+		}
+	}
+
+	void operator()(std::function<void()> task) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			tasks.push(std::move(task));
+		}
+		available.notify_one();
+	}
+
+private:
+	std::vector<std::thread> threads;
+	std::queue<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable available;
+	bool running;
+};
+
+}  // namespace test
+
+#endif /* THREAD_POOL_H_ */
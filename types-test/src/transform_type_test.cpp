@@ -13,6 +13,9 @@
 * See the License for the specific language governing permissions and
 * limitations under the License.
 */
+#include <atomic>
+#include <stdexcept>
+#include <thread>
 #include <gtest/gtest.h>
 #include <type/transform.h>
 
@@ -119,3 +122,131 @@ TEST(TransformTypeTest, RedundantFlush) {
 	}
 	ASSERT_EQ(counter, 1);
 }
+
+TEST(TransformTypeTest, Evaluate) {
+	typedef type::readable_t_array<float, true> read_type;
+	typedef type::read_transform_array_type<float> read_transform_type;
+	std::atomic<int> counter(0);
+	const auto scale([&](const read_type &input, type::writable_t_array<float> &&output) {
+		std::transform(std::begin(input), std::end(input), std::begin(output),
+			[](float value) { return value * 2; });
+		++counter;
+	});
+	const auto bounds([&](const read_transform_type &input, type::writable_t_array<float> &&output) {
+		output[0] = *std::max_element(std::begin(input), std::end(input));
+		++counter;
+	});
+	type::t_array<float> array1({ 1, 2, 3 }), array2({ 4, 5 });
+	// Two independent chains joined by the last transform.
+	auto skinned1(type::make_transform(type::t_array<float>(3), scale, std::ref(array1)));
+	auto skinned2(type::make_transform(type::t_array<float>(2), scale, std::ref(array2)));
+	auto bounds1(type::make_transform(type::t_array<float>(1), bounds, std::ref(skinned1)));
+	auto bounds2(type::make_transform(type::t_array<float>(1), bounds, std::ref(skinned2)));
+	auto culled(type::make_transform(type::t_array<float>(1),
+		[&](const read_transform_type &bounds1, const read_transform_type &bounds2,
+			type::writable_t_array<float> &&output) {
+		output[0] = std::max(bounds1[0], bounds2[0]);
+		++counter;
+	}, std::ref(bounds1), std::ref(bounds2)));
+
+	std::mutex mutex;
+	std::vector<std::thread> threads;
+	const type::executor_type executor([&](std::function<void()> task) {
+		std::lock_guard<std::mutex> lock(mutex);
+		threads.push_back(std::thread(std::move(task)));
+	});
+	type::evaluate(executor, culled);
+	ASSERT_EQ(5, counter.load());
+	ASSERT_EQ(5u, threads.size());
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (std::thread &thread : threads) {
+			thread.join();
+		}
+	}
+	ASSERT_EQ(10.f, type::read(culled)[0]);
+	ASSERT_EQ(5, counter.load());
+
+	// Only the chain reading array1 runs again.
+	type::write(array1)[2] = 8;
+	threads.clear();
+	type::evaluate(executor, culled, bounds2);
+	ASSERT_EQ(8, counter.load());
+	for (std::thread &thread : threads) {
+		thread.join();
+	}
+	ASSERT_EQ(16.f, type::read(culled)[0]);
+	ASSERT_EQ(8, counter.load());
+}
+
+TEST(TransformTypeTest, EvaluateExecutorThrows) {
+	std::atomic<int> counter(0);
+	const auto scale([&](const type::readable_t_array<float, true> &input,
+			type::writable_t_array<float> &&output) {
+		std::transform(std::begin(input), std::end(input), std::begin(output),
+			[](float value) { return value * 2; });
+		++counter;
+	});
+	type::t_array<float> array({ 1, 2, 3 });
+	auto first(type::make_transform(type::t_array<float>(3), scale, std::ref(array)));
+	auto second(type::make_transform(type::t_array<float>(3), scale, std::ref(first)));
+
+	// The first transform runs on a thread, scheduling the second throws there.
+	std::mutex mutex;
+	std::vector<std::thread> threads;
+	const type::executor_type executor([&](std::function<void()> task) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!threads.empty()) {
+			throw std::runtime_error("executor");
+		}
+		threads.push_back(std::thread(std::move(task)));
+	});
+	ASSERT_THROW(type::evaluate(executor, second), std::runtime_error);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (std::thread &thread : threads) {
+			thread.join();
+		}
+	}
+	ASSERT_EQ(1, counter.load());
+	// Reading runs what evaluate left out.
+	ASSERT_EQ(12.f, type::read(second)[2]);
+	ASSERT_EQ(2, counter.load());
+}
+
+TEST(TransformTypeTest, Incremental) {
+	type::t_array<float> input(1000, 1.f);
+	std::size_t written(0);
+	auto transform(type::make_incremental_transform(type::t_array<float>(input.size()),
+		[&](const std::vector<type::index_range_type> &changed,
+			const type::readable_t_array<float, true> &input,
+			type::writable_t_array<float> &&output) {
+		for (const type::index_range_type &range : changed) {
+			for (std::size_t i = range.first; i < range.last; ++i) {
+				output[i] = input[i] * 2;
+			}
+			written += range.last - range.first;
+		}
+	}, std::ref(input)));
+	ASSERT_EQ(2.f, type::read(transform)[999]);
+	ASSERT_EQ(input.size(), written);
+
+	written = 0;
+	{
+		auto write_input(type::write(input));
+		write_input[10] = 3;
+		write_input[900] = 4;
+	}
+	{
+		auto read_transform(type::read(transform));
+		ASSERT_EQ(6.f, read_transform[10]);
+		ASSERT_EQ(8.f, read_transform[900]);
+		ASSERT_EQ(2.f, read_transform[500]);
+	}
+	ASSERT_GE(written, 2u);
+	ASSERT_LT(written, 100u);
+
+	written = 0;
+	type::read(transform);
+	ASSERT_EQ(0u, written);
+}
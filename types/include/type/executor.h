@@ -0,0 +1,29 @@
+/*
+* Copyright 2016 Google Inc. All Rights Reserved.
+
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+
+* http://www.apache.org/licenses/LICENSE-2.0
+
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#ifndef GTYPE_EXECUTOR_H_
+#define GTYPE_EXECUTOR_H_
+
+#include <functional>
+
+namespace type {
+
+// Runs a task, possibly on another thread, such as by handing it to the
+// thread pool of the application.
+typedef std::function<void(std::function<void()>)> executor_type;
+
+}  // namespace type
+
+#endif // GTYPE_EXECUTOR_H_
@@ -0,0 +1,175 @@
+/*
+* Copyright 2016 Google Inc. All Rights Reserved.
+
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+
+* http://www.apache.org/licenses/LICENSE-2.0
+
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#ifndef GTYPE_EXTERNAL_H_
+#define GTYPE_EXTERNAL_H_
+
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <type/storage.h>
+
+namespace type {
+
+template<typename T>
+class external_storage_type;
+template<typename T>
+class readable_external_type;
+template<typename T>
+class writable_external_type;
+
+template<typename T>
+readable_external_type<T> read(const external_storage_type<T> &storage);
+template<typename T>
+writable_external_type<T> write(external_storage_type<T> &storage);
+
+namespace internal {
+
+// The container interface of storage_type over size elements at data,
+// owner keeping them alive if set. Elements of a const T are read-only.
+template<typename T>
+class external_container_type {
+public:
+	typedef T *iterator;
+	typedef const T *const_iterator;
+	typedef std::size_t size_type;
+	typedef typename std::remove_const<T>::type value_type;
+	typedef T &reference;
+	typedef const T &const_reference;
+	typedef T *pointer;
+	typedef const T *const_pointer;
+
+	external_container_type(T *data, std::size_t size,
+			const std::shared_ptr<const void> &owner)
+		: pointer_(data), count(size), owner(owner) {}
+
+	iterator begin() {
+		return pointer_;
+	}
+
+	iterator end() {
+		return pointer_ + count;
+	}
+
+	const_iterator cbegin() const {
+		return pointer_;
+	}
+
+	const_iterator cend() const {
+		return pointer_ + count;
+	}
+
+	reference operator[] (std::size_t index) {
+		return pointer_[index];
+	}
+
+	const_reference operator[] (std::size_t index) const {
+		return pointer_[index];
+	}
+
+	const_pointer data() const {
+		return pointer_;
+	}
+
+	size_type size() const {
+		return count;
+	}
+
+private:
+	T *pointer_;
+	std::size_t count;
+	std::shared_ptr<const void> owner;
+};
+
+template<typename T>
+using external_base_type = storage_type<T, !std::is_const<T>::value, true,
+	external_container_type<T>>;
+
+}  // namespace internal
+
+// An array over memory owned by the caller, such as a memory mapped file or
+// an arena, with the revisions and locking of storage_type. Elements are
+// read and serialized in place, without a copy into a std::vector.
+// An external_storage_type<const T> is read-only, such as for a file mapped
+// without write access.
+// The memory must outlive the storage, unless kept alive by owner.
+template<typename T>
+class external_storage_type : public internal::external_base_type<T> {
+	typedef internal::external_container_type<T> container_type;
+
+public:
+	external_storage_type(T *data, std::size_t size,
+			const std::shared_ptr<const void> &owner = std::shared_ptr<const void>())
+		: internal::external_base_type<T>(std::make_tuple(
+			container_type(data, size, owner), revision_type(1))) {}
+	external_storage_type(const external_storage_type &) = delete;
+	external_storage_type &operator=(const external_storage_type &) = delete;
+};
+
+// Shares the lock of the storage with other readers.
+template<typename T>
+class readable_external_type : public internal::readable_storage_type<T,
+		!std::is_const<T>::value, true, internal::external_container_type<T>> {
+	template<typename U>
+	friend readable_external_type<U> read(const external_storage_type<U> &storage);
+
+	typedef internal::readable_storage_type<T, !std::is_const<T>::value, true,
+		internal::external_container_type<T>> base_type;
+
+	explicit readable_external_type(const external_storage_type<T> &storage)
+		: base_type(storage, typename base_type::lock_type(internal::get_lock(storage))) {}
+
+public:
+	readable_external_type() = default;
+	readable_external_type(readable_external_type &&) = default;
+	readable_external_type &operator=(readable_external_type &&) = default;
+};
+
+// Holds the lock of the storage exclusively, increments the revision when
+// destroyed. Only for storages of a non-const T.
+template<typename T>
+class writable_external_type : public writable_storage_type<T, true,
+		internal::external_container_type<T>> {
+	template<typename U>
+	friend writable_external_type<U> write(external_storage_type<U> &storage);
+
+	typedef writable_storage_type<T, true, internal::external_container_type<T>> base_type;
+
+	explicit writable_external_type(external_storage_type<T> &storage)
+		: base_type(storage, typename base_type::lock_type(internal::get_lock(storage))) {}
+
+public:
+	writable_external_type() = default;
+	writable_external_type(writable_external_type &&) = default;
+	writable_external_type &operator=(writable_external_type &&) = default;
+};
+
+template<typename T>
+readable_external_type<T> read(const external_storage_type<T> &storage) {
+	return readable_external_type<T>(storage);
+}
+
+template<typename T>
+writable_external_type<T> write(external_storage_type<T> &storage) {
+	static_assert(!std::is_const<T>::value, "the elements are read-only");
+	return writable_external_type<T>(storage);
+}
+
+template<typename T>
+using t_external_array = external_storage_type<T>;
+
+}  // namespace type
+
+#endif // GTYPE_EXTERNAL_H_
@@ -20,7 +20,7 @@ namespace type {
 namespace internal {
 
 template<typename T>
-auto get_revision(T &v)->decltype(v.get_revision())& {
+auto get_revision(T &v)->decltype(v.get_revision()) {
 	return v.get_revision();
 }
 
@@ -34,6 +34,16 @@ auto get_lock(T &v)->decltype(v.get_lock())& {
 	return v.get_lock();
 }
 
+template<typename T>
+auto get_dirty(T &v)->decltype(v.get_dirty())& {
+	return v.get_dirty();
+}
+
+template<typename T>
+auto get_notifier(T &v)->decltype(v.get_notifier())& {
+	return v.get_notifier();
+}
+
 }  // namespace internal
 }  // namespace type
 
@@ -0,0 +1,96 @@
+/*
+* Copyright 2016 Google Inc. All Rights Reserved.
+
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+
+* http://www.apache.org/licenses/LICENSE-2.0
+
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#ifndef GTYPE_REGISTRY_H_
+#define GTYPE_REGISTRY_H_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace type {
+namespace internal {
+
+// Owned by a storage, lists the flags of the serializes reading it.
+struct notifier_type {
+	notifier_type() : queued(false), subscribed(false) {}
+	notifier_type(const notifier_type &) = delete;
+	notifier_type &operator=(const notifier_type &) = delete;
+
+	// Set while the storage is in the dirty list of the registry.
+	std::atomic<bool> queued;
+	// Writes to storages nobody subscribed to are not queued.
+	std::atomic<bool> subscribed;
+	std::mutex mutex;
+	std::vector<std::weak_ptr<std::atomic<bool>>> subscribers;
+};
+
+// changed is set by registry_type::collect once the storage is written.
+void subscribe(notifier_type &notifier, const std::shared_ptr<std::atomic<bool>> &changed);
+
+// Tracks the storages written since the last collect, so the serializes of
+// the storages that did not change are not scanned.
+class registry_type {
+public:
+	registry_type() : head(nullptr), collecting(0) {}
+	registry_type(const registry_type &) = delete;
+	registry_type &operator=(const registry_type &) = delete;
+	~registry_type();
+
+	// Lock-free, called by writers once the revision is incremented.
+	// A storage is queued at most once until collected.
+	void notify(const std::shared_ptr<notifier_type> &notifier);
+
+	// Sets the changed flag of every subscriber of the storages notified since
+	// the previous collect. Once it returns, all notifications made before the
+	// call are collected, by this or a concurrent call.
+	// Returns the number of storages collected by this call.
+	std::size_t collect();
+
+private:
+	struct node_type {
+		std::weak_ptr<notifier_type> notifier;
+		node_type *next;
+	};
+
+	std::atomic<node_type *> head;
+	std::atomic<std::size_t> collecting;
+	std::mutex mutex;
+};
+
+// The registry all storages notify.
+registry_type &get_registry();
+
+// Collects, unless the calling thread is within a collect_batch_type.
+void collect_unless_batched();
+
+// Collects once when constructed. Until destroyed, dirty on the same thread
+// does not collect again, so a pass checking many serializes, such as the
+// pre-execute hooks of a submit, takes the registry mutex once. Writes made
+// meanwhile are picked up by the next collect. May be nested.
+class collect_batch_type {
+public:
+	collect_batch_type();
+	collect_batch_type(const collect_batch_type &) = delete;
+	collect_batch_type &operator=(const collect_batch_type &) = delete;
+	~collect_batch_type();
+};
+
+}  // namespace internal
+}  // namespace type
+
+#endif // GTYPE_REGISTRY_H_
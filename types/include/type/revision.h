@@ -16,10 +16,13 @@
 #ifndef GTYPE_REVISION_TYPE_H_
 #define GTYPE_REVISION_TYPE_H_
 
+#include <cstdint>
+
 namespace type {
 
-// Not using 64 bit, even with 100 updates/second it will take +1 year to overflow.
-typedef unsigned long revision_type;
+// 64 bit on every platform so revisions never overflow in practice. Storages
+// keep theirs in a std::atomic so it can be compared without taking the lock.
+typedef uint64_t revision_type;
 // If a container returns REVISION_NONE it doesn't use a revision system.
 // An Adapter has its initial value set to REVISION_NONE to force an update.
 // (the default revision is 1)
@@ -18,7 +18,17 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <type/executor.h>
 #include <type/memory.h>
+#include <type/registry.h>
 #include <type/supplier.h>
 #include <type/types.h>
 
@@ -111,60 +121,238 @@ template<> struct calculate_layout_type<interleaved_std140>
 template<> struct calculate_layout_type<interleaved_std430>
 	: calculate_interleaved_layout_type<interleaved_std430> {};
 
+// Byte range [offset, offset + size) of a serialized buffer.
+struct byte_range_type {
+	std::size_t offset, size;
+};
+
+// Copies the elements [first, last) of values, element i to bytes + i * stride.
+// Chosen at compile time from the layout and the element type.
+template<memory_layout Layout, typename T, bool Bitwise = is_bitwise<Layout, T>::value>
+struct copy_plan_type {
+
+	template<typename Values>
+	static void copy(const Values &values, std::size_t first, std::size_t last,
+			std::size_t stride, uint8_t *bytes) {
+		for (std::size_t i = first; i < last; ++i) {
+			primitive_type_information<Layout, T>::copy(values[i], bytes + i * stride);
+		}
+	}
+};
+
+// Storages are contiguous, so a run is a single memcpy when the layout packs
+// the elements as tightly as memory does, otherwise one memcpy of a size
+// known at compile time per element.
+template<memory_layout Layout, typename T>
+struct copy_plan_type<Layout, T, true> {
+	constexpr static std::size_t size = primitive_type_information<Layout, T>::size;
+
+	template<typename Values>
+	static void copy(const Values &values, std::size_t first, std::size_t last,
+			std::size_t stride, uint8_t *bytes) {
+		if (first == last) {
+			return;
+		}
+		const T *source(&values[first]);
+		if (size == sizeof(T) && stride == sizeof(T)) {
+			std::memcpy(bytes + first * stride, source, (last - first) * sizeof(T));
+		} else {
+			for (std::size_t i = first; i < last; ++i, ++source) {
+				std::memcpy(bytes + i * stride, source, size);
+			}
+		}
+	}
+};
+
+// Splits the copies of a flush in tasks of about grain bytes for an executor.
+// The storages read are kept locked until wait returns, each destination
+// range is written by a single task.
+class parallel_type {
+public:
+	parallel_type(const executor_type &executor, std::size_t grain)
+		: executor(executor), grain(std::max(grain, std::size_t(1))), batch_bytes(0), pending(0) {}
+	parallel_type(const parallel_type &) = delete;
+	parallel_type &operator=(const parallel_type &) = delete;
+	// Waits for the tasks already handed to the executor.
+	~parallel_type();
+
+	// Moves value to be destroyed on the calling thread after wait.
+	template<typename T>
+	T &keep(T &&value) {
+		std::shared_ptr<T> kept_value(std::make_shared<T>(std::move(value)));
+		kept.push_back(kept_value);
+		return *kept_value;
+	}
+
+	template<memory_layout Layout, typename T, typename Values>
+	void copy(const Values &values, std::size_t first, std::size_t last,
+			std::size_t stride, uint8_t *bytes) {
+		const std::size_t elements(std::max(grain / stride, std::size_t(1)));
+		for (std::size_t begin = first; begin < last; begin += elements) {
+			const std::size_t end(std::min(last, begin + elements));
+			add([&values, begin, end, stride, bytes]() {
+				copy_plan_type<Layout, T>::copy(values, begin, end, stride, bytes);
+			}, (end - begin) * stride);
+		}
+	}
+
+	// Runs what is left, inline if nothing was handed to the executor,
+	// and waits for all tasks. Rethrows the first exception of a task.
+	void wait();
+
+private:
+	// Batches small copies until they sum up to grain bytes.
+	void add(std::function<void()> &&task, std::size_t bytes);
+	// Hands the batch to the executor, rethrowing if the executor throws.
+	void submit();
+	// Called once per submitted batch, whether it ran or failed.
+	void finish(const std::exception_ptr &task_exception);
+
+	const executor_type &executor;
+	const std::size_t grain;
+	std::vector<std::function<void()>> batch;
+	std::size_t batch_bytes;
+	std::vector<std::shared_ptr<void>> kept;
+	std::mutex mutex;
+	std::condition_variable done;
+	std::size_t pending;
+	std::exception_ptr exception;
+};
+
+// Serializes the elements written since revision and appends their byte ranges.
+// revision is updated to the serialized revision. With parallel, the copies
+// are left to parallel and done once it has waited.
 template<memory_layout Layout, typename Storage>
-void serialize(const Storage &storage, std::size_t offset, std::size_t stride, void *target) {
+void serialize(Storage &storage, std::size_t offset, std::size_t stride,
+		std::atomic<revision_type> &revision, void *target, std::vector<byte_range_type> &ranges,
+		parallel_type *parallel) {
+	if (revision != REVISION_NONE && get_revision(storage) == revision) {
+		return;
+	}
 	uint8_t *bytes(reinterpret_cast<uint8_t *>(target) + offset);
 
 	auto values(read(storage));
-	for (const auto &value : values) {
-		primitive_type_information<Layout, typename Storage::value_type>::copy(value, bytes);
-		bytes += stride;
+	const auto &source(parallel ? parallel->keep(std::move(values)) : values);
+	auto &view(get_view(storage, source, 0));
+	const revision_type current(get_revision(view));
+	for_each_dirty(view, revision, [&](std::size_t first, std::size_t last) {
+		if (parallel) {
+			parallel->copy<Layout, typename Storage::value_type>(source, first, last,
+				stride, bytes);
+		} else {
+			copy_plan_type<Layout, typename Storage::value_type>::copy(source, first, last,
+				stride, bytes);
+		}
+		ranges.push_back(byte_range_type{ offset + first * stride, (last - first) * stride });
+	});
+	revision = current;
+}
+
+// Sorts ranges and merges the ones overlapping or touching.
+inline void merge(std::vector<byte_range_type> &ranges) {
+	std::sort(ranges.begin(), ranges.end(),
+		[](const byte_range_type &a, const byte_range_type &b) {
+		return a.offset < b.offset;
+	});
+	std::size_t merged(0);
+	for (std::size_t i = 1; i < ranges.size(); ++i) {
+		byte_range_type &last(ranges[merged]);
+		if (ranges[i].offset <= last.offset + last.size) {
+			last.size = std::max(last.offset + last.size,
+				ranges[i].offset + ranges[i].size) - last.offset;
+		} else {
+			ranges[++merged] = ranges[i];
+		}
+	}
+	if (!ranges.empty()) {
+		ranges.resize(merged + 1);
 	}
 }
 
 template<std::size_t I>
 struct serialize_storage_type {
 
-	template<typename Layout, typename Storages>
-	static void serialize(const Layout &layout, const Storages &storages, void *target) {
+	template<typename Layout, typename Storages, typename Revisions>
+	static void serialize(const Layout &layout, const Storages &storages,
+			Revisions &revisions, void *target, std::vector<byte_range_type> &ranges,
+			parallel_type *parallel) {
 		constexpr std::size_t index = I - 1;
 		internal::serialize<Layout::layout>(*std::get<index>(storages),
-			std::get<index>(layout.offset), std::get<index>(layout.stride), target);
-		serialize_storage_type<index>::serialize(layout, storages, target);
+			std::get<index>(layout.offset), std::get<index>(layout.stride),
+			std::get<index>(revisions), target, ranges, parallel);
+		serialize_storage_type<index>::serialize(layout, storages, revisions, target, ranges,
+			parallel);
 	}
 };
 
 template<>
 struct serialize_storage_type<0> {
-	template<typename Layout, typename Storages>
-	static void serialize(const Layout &layout, const Storages &storages, void *target) {}
+	template<typename Layout, typename Storages, typename Revisions>
+	static void serialize(const Layout &layout, const Storages &storages,
+		Revisions &revisions, void *target, std::vector<byte_range_type> &ranges,
+		parallel_type *parallel) {}
+};
+
+// True if any storage has a revision other than the serialized one.
+// Only atomic loads, neither the storages nor the serialize are locked.
+template<std::size_t I>
+struct serialize_dirty_type {
+
+	template<typename Storages, typename Revisions>
+	static bool dirty(const Storages &storages, const Revisions &revisions) {
+		return get_revision(*std::get<I - 1>(storages)) != std::get<I - 1>(revisions)
+			|| serialize_dirty_type<I - 1>::dirty(storages, revisions);
+	}
+};
+
+template<>
+struct serialize_dirty_type<0> {
+
+	template<typename Storages, typename Revisions>
+	static bool dirty(const Storages &storages, const Revisions &revisions) {
+		return false;
+	}
 };
 
+template<typename Storage>
+auto subscribe(Storage &storage, const std::shared_ptr<std::atomic<bool>> &changed, int)
+		->decltype(get_notifier(storage), bool()) {
+	subscribe(*get_notifier(storage), changed);
+	return true;
+}
+
+template<typename Storage>
+bool subscribe(Storage &storage, const std::shared_ptr<std::atomic<bool>> &changed, long) {
+	return false;
+}
+
+// Subscribes changed to the storages notifying the registry.
+// Returns false if any of them does not.
 template<std::size_t I>
-struct serialize_revision_type {
+struct serialize_subscribe_type {
 
-	template<typename Layout, typename Storages>
-	static std::array<revision_type, std::tuple_size<Storages>::value> revision(
-			const Layout &layout, const Storages &storages) {
-		auto revision(serialize_revision_type<I - 1>::revision(layout, storages));
-		std::get<I - 1>(revision) = get_revision(*std::get<I - 1>(storages));
-		return revision;
+	template<typename Storages>
+	static bool subscribe(const Storages &storages,
+			const std::shared_ptr<std::atomic<bool>> &changed) {
+		const bool notifies(internal::subscribe(*std::get<I - 1>(storages), changed, 0));
+		return serialize_subscribe_type<I - 1>::subscribe(storages, changed) && notifies;
 	}
 };
 
 template<>
-struct serialize_revision_type<0> {
+struct serialize_subscribe_type<0> {
 
-	template<typename Layout, typename Storages>
-	static std::array<revision_type, std::tuple_size<Storages>::value> revision(
-			const Layout &layout, const Storages &storages) {
-		return std::array<revision_type, std::tuple_size<Storages>::value>();
+	template<typename Storages>
+	static bool subscribe(const Storages &storages,
+			const std::shared_ptr<std::atomic<bool>> &changed) {
+		return true;
 	}
 };
 
 struct serialize_type_impl {
 
-	virtual void flush(void *target) = 0;
+	virtual void flush(void *target, std::vector<byte_range_type> &ranges,
+		parallel_type *parallel) = 0;
 	virtual bool dirty() const = 0;
 };
 
@@ -172,26 +360,50 @@ template<typename Layout, typename Storages>
 struct template_serialize_type_impl : serialize_type_impl {
 
 	template_serialize_type_impl(Layout &&layout, const Storages &storages)
-		: layout(std::forward<Layout>(layout)), storages(storages) {
+		: layout(std::forward<Layout>(layout)), storages(storages),
+		  changed(std::make_shared<std::atomic<bool>>(true)),
+		  polled(!serialize_subscribe_type<std::tuple_size<Storages>::value>::subscribe(
+			  storages, changed)) {
 		std::fill(std::begin(revision), std::end(revision), REVISION_NONE);
 	}
 
-	virtual void flush(void *target) override {
-		serialize_storage_type<std::tuple_size<Storages>::value>
-			::serialize(layout, storages, target);
-		revision = serialize_revision_type<std::tuple_size<Storages>::value>::revision(layout,
-			storages);
+	virtual void flush(void *target, std::vector<byte_range_type> &ranges,
+			parallel_type *parallel) override {
+		// Cleared before reading, a write after this sets it again.
+		*changed = false;
+		try {
+			serialize_storage_type<std::tuple_size<Storages>::value>
+				::serialize(layout, storages, revision, target, ranges, parallel);
+			if (parallel) {
+				parallel->wait();
+			}
+		} catch (...) {
+			// Some copies may be missing, the next flush writes everything.
+			for (std::atomic<revision_type> &storage_revision : revision) {
+				storage_revision = REVISION_NONE;
+			}
+			*changed = true;
+			throw;
+		}
+		merge(ranges);
 	}
 
+	// Unless a storage does not notify the registry, the revisions are only
+	// compared once one of the storages was written.
 	virtual bool dirty() const override {
-		auto current_revision(serialize_revision_type<std::tuple_size<Storages>::value>::revision(
-			layout, storages));
-		return current_revision > revision;
+		collect_unless_batched();
+		return (polled || *changed)
+			&& serialize_dirty_type<std::tuple_size<Storages>::value>::dirty(storages, revision);
 	}
 
 	Layout layout;
 	Storages storages;
-	std::array<revision_type, std::tuple_size<Storages>::value> revision;
+	// The serialized revision of each storage, written by flush and read by dirty.
+	std::array<std::atomic<revision_type>, std::tuple_size<Storages>::value> revision;
+	// Set by the registry when a storage is written, see registry.h.
+	const std::shared_ptr<std::atomic<bool>> changed;
+	// Whether some storage does not notify, such as a transform_type.
+	const bool polled;
 };
 
 template<typename Layout, typename... Storage>
@@ -226,8 +438,31 @@ serialize_type make_serialize(const type::supplier<Storages> &... storages) {
 		storages...);
 }
 
+typedef internal::byte_range_type byte_range_type;
+
+// Serializes the elements written since the previous flush into target,
+// which must hold the previously flushed content. The written byte ranges
+// are appended to ranges, sorted and merged. The first flush writes everything.
+inline void flush(const serialize_type &serialize, void *target,
+		std::vector<byte_range_type> &ranges) {
+	serialize.impl->flush(target, ranges, nullptr);
+}
+
+// As flush, with the copies split across storages and element ranges in
+// tasks of about grain bytes run by executor. Returns once all have run.
+// Small flushes are done on the calling thread. If a task or executor throws,
+// the first exception is rethrown once the tasks handed over have finished
+// and the next flush writes everything again.
+inline void flush(const serialize_type &serialize, void *target,
+		std::vector<byte_range_type> &ranges, const executor_type &executor,
+		std::size_t grain = std::size_t(1) << 20) {
+	internal::parallel_type parallel(executor, grain);
+	serialize.impl->flush(target, ranges, &parallel);
+}
+
 inline void flush(const serialize_type &serialize, void *target) {
-	serialize.impl->flush(target);
+	std::vector<byte_range_type> ranges;
+	flush(serialize, target, ranges);
 }
 
 inline std::size_t size(const serialize_type &serialize) {
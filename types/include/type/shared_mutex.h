@@ -0,0 +1,156 @@
+/*
+* Copyright 2016 Google Inc. All Rights Reserved.
+
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+
+* http://www.apache.org/licenses/LICENSE-2.0
+
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#ifndef GTYPE_SHARED_MUTEX_H_
+#define GTYPE_SHARED_MUTEX_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+namespace type {
+
+// Reader/writer mutex, C++11 lacks std::shared_mutex.
+// Waiting writers block new readers so a steady stream of readers can not
+// starve them. Neither mode is recursive.
+class shared_mutex_type {
+public:
+	shared_mutex_type() : readers(0), writer(false), waiting_writers(0) {}
+	shared_mutex_type(const shared_mutex_type &) = delete;
+	shared_mutex_type &operator=(const shared_mutex_type &) = delete;
+
+	void lock() {
+		std::unique_lock<std::mutex> lock(mutex);
+		++waiting_writers;
+		writer_condition.wait(lock, [this]() { return !writer && !readers; });
+		--waiting_writers;
+		writer = true;
+	}
+
+	bool try_lock() {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (writer || readers) {
+			return false;
+		}
+		writer = true;
+		return true;
+	}
+
+	void unlock() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			writer = false;
+		}
+		writer_condition.notify_one();
+		reader_condition.notify_all();
+	}
+
+	void lock_shared() {
+		std::unique_lock<std::mutex> lock(mutex);
+		reader_condition.wait(lock, [this]() { return !writer && !waiting_writers; });
+		++readers;
+	}
+
+	bool try_lock_shared() {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (writer || waiting_writers) {
+			return false;
+		}
+		++readers;
+		return true;
+	}
+
+	void unlock_shared() {
+		bool last;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			last = !--readers;
+		}
+		if (last) {
+			writer_condition.notify_one();
+		}
+	}
+
+private:
+	std::mutex mutex;
+	std::condition_variable reader_condition, writer_condition;
+	std::size_t readers;
+	bool writer;
+	std::size_t waiting_writers;
+};
+
+// std::unique_lock for the shared mode of Mutex, like C++14 std::shared_lock.
+template<typename Mutex>
+class shared_lock_type {
+public:
+	typedef Mutex mutex_type;
+
+	shared_lock_type() : mutex(nullptr), owns(false) {}
+	explicit shared_lock_type(mutex_type &mutex) : mutex(&mutex), owns(true) {
+		mutex.lock_shared();
+	}
+	shared_lock_type(mutex_type &mutex, std::defer_lock_t) : mutex(&mutex), owns(false) {}
+	shared_lock_type(mutex_type &mutex, std::try_to_lock_t)
+		: mutex(&mutex), owns(mutex.try_lock_shared()) {}
+	// mutex must be locked in shared mode by the caller.
+	shared_lock_type(mutex_type &mutex, std::adopt_lock_t) : mutex(&mutex), owns(true) {}
+	shared_lock_type(const shared_lock_type &) = delete;
+	shared_lock_type(shared_lock_type &&copy) : mutex(copy.mutex), owns(copy.owns) {
+		copy.mutex = nullptr;
+		copy.owns = false;
+	}
+	shared_lock_type &operator=(const shared_lock_type &) = delete;
+	shared_lock_type &operator=(shared_lock_type &&copy) {
+		if (owns) {
+			mutex->unlock_shared();
+		}
+		mutex = copy.mutex;
+		owns = copy.owns;
+		copy.mutex = nullptr;
+		copy.owns = false;
+		return *this;
+	}
+	~shared_lock_type() {
+		if (owns) {
+			mutex->unlock_shared();
+		}
+	}
+
+	void lock() {
+		mutex->lock_shared();
+		owns = true;
+	}
+
+	bool try_lock() {
+		return owns = mutex->try_lock_shared();
+	}
+
+	void unlock() {
+		mutex->unlock_shared();
+		owns = false;
+	}
+
+	bool owns_lock() const {
+		return owns;
+	}
+
+private:
+	mutex_type *mutex;
+	bool owns;
+};
+
+}  // namespace type
+
+#endif // GTYPE_SHARED_MUTEX_H_
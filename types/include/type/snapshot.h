@@ -0,0 +1,389 @@
+/*
+* Copyright 2016 Google Inc. All Rights Reserved.
+
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+
+* http://www.apache.org/licenses/LICENSE-2.0
+
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#ifndef GTYPE_SNAPSHOT_H_
+#define GTYPE_SNAPSHOT_H_
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <type/internal.h>
+#include <type/registry.h>
+#include <type/revision.h>
+#include <type/storage.h>
+
+namespace type {
+
+template<typename T>
+class snapshot_storage_type;
+template<typename T>
+class readable_snapshot_type;
+template<typename T>
+class writable_snapshot_type;
+
+template<typename T>
+readable_snapshot_type<T> read(const snapshot_storage_type<T> &storage);
+template<typename T>
+writable_snapshot_type<T> write(snapshot_storage_type<T> &storage);
+
+namespace internal {
+
+// The elements as of revision, along with the revisions they were written in.
+template<typename T>
+struct snapshot_type {
+	std::vector<T> values;
+	dirty_type dirty;
+	revision_type revision;
+};
+
+}  // namespace internal
+
+// An array storage where readers get an immutable snapshot of the last
+// written revision instead of holding a lock, so a writer never waits for
+// a reader such as a serializer uploading to the GPU, and the reader always
+// sees a consistent revision.
+// Writes go to a back copy published when the writable_snapshot_type is
+// destroyed. A retired snapshot no reader holds anymore is then recycled as
+// the next back copy, catching up only the chunks logged as written since,
+// so a publish costs about as much as the write did. Retired snapshots are
+// kept for reuse, the storage grows to as many copies as were held at once
+// plus two, and the array is only copied when a new copy is needed or the
+// log was trimmed past the revision of the recycled one.
+// Readers must not outlive the storage.
+template<typename T>
+class snapshot_storage_type {
+	template<typename U>
+	friend auto type::internal::get_revision(U &v)
+		->decltype(v.get_revision());
+	template<typename U>
+	friend auto type::internal::get_notifier(U &v)->decltype(v.get_notifier())&;
+	template<typename U>
+	friend readable_snapshot_type<U> read(const snapshot_storage_type<U> &storage);
+	template<typename U>
+	friend writable_snapshot_type<U> write(snapshot_storage_type<U> &storage);
+	friend class writable_snapshot_type<T>;
+
+	typedef internal::snapshot_type<T> snapshot_type;
+	typedef std::vector<T> container_type;
+	// A chunk written in a revision, all_chunks when every element was.
+	typedef std::pair<revision_type, std::size_t> written_type;
+	static const std::size_t chunk_size = internal::dirty_type::chunk_size,
+		all_chunks = std::size_t(-1);
+
+public:
+	static const bool is_array = true;
+
+	typedef typename container_type::iterator iterator;
+	typedef typename container_type::const_iterator const_iterator;
+	typedef typename container_type::size_type size_type;
+	typedef typename container_type::value_type value_type;
+	typedef typename container_type::reference reference;
+	typedef typename container_type::const_reference const_reference;
+	typedef typename container_type::pointer pointer;
+	typedef typename container_type::const_pointer const_pointer;
+
+	explicit snapshot_storage_type(std::size_t size, const T &value = T())
+		: snapshot_storage_type(container_type(size, value)) {}
+
+	template<typename IteratorT>
+	snapshot_storage_type(IteratorT begin, IteratorT end)
+		: snapshot_storage_type(container_type(begin, end)) {}
+
+	snapshot_storage_type(std::initializer_list<value_type> &&initializer)
+		: snapshot_storage_type(container_type(
+			std::forward<std::initializer_list<value_type>>(initializer))) {}
+
+	snapshot_storage_type(const snapshot_storage_type &) = delete;
+	snapshot_storage_type &operator=(const snapshot_storage_type &) = delete;
+
+	size_type size() const {
+		return count;
+	}
+
+private:
+	// A published snapshot, released once no reader holds it anymore.
+	struct retired_type {
+		std::unique_ptr<snapshot_type> snapshot;
+		std::shared_ptr<std::atomic<bool>> released;
+	};
+
+	explicit snapshot_storage_type(container_type &&values)
+		: count(values.size()),
+		  back(new snapshot_type{ values, internal::dirty_type(1), 1 }),
+		  log_start(1), revision(1),
+		  notifier(std::make_shared<internal::notifier_type>()) {
+		current.snapshot.reset(new snapshot_type{ std::move(values), internal::dirty_type(1), 1 });
+		front = handle(current);
+	}
+
+	std::atomic<revision_type> &get_revision() {
+		return revision;
+	}
+
+	const std::shared_ptr<internal::notifier_type> &get_notifier() const {
+		return notifier;
+	}
+
+	std::shared_ptr<const snapshot_type> get_front() const {
+		std::lock_guard<std::mutex> lock(front_mutex);
+		return front;
+	}
+
+	// A reference to snapshot setting released when the last copy is dropped.
+	static std::shared_ptr<const snapshot_type> handle(retired_type &snapshot) {
+		std::shared_ptr<std::atomic<bool>> released(std::make_shared<std::atomic<bool>>(false));
+		snapshot.released = released;
+		return std::shared_ptr<const snapshot_type>(snapshot.snapshot.get(),
+			[released](const snapshot_type *) {
+			released->store(true, std::memory_order_release);
+		});
+	}
+
+	// Called by the writer, with writer_mutex held.
+	void mark(std::size_t index) {
+		const revision_type written(back->revision + 1);
+		if (back->dirty.mark(index, count, written)) {
+			log.emplace_back(written, index / chunk_size);
+		}
+	}
+
+	void mark_all() {
+		const revision_type written(back->revision + 1);
+		if (back->dirty.mark_all(written)) {
+			log.emplace_back(written, all_chunks);
+		}
+	}
+
+	void publish() {
+		++back->revision;
+		retired.push_back(std::move(current));
+		current.snapshot = std::move(back);
+		std::shared_ptr<const snapshot_type> published(handle(current)), previous;
+		{
+			std::lock_guard<std::mutex> lock(front_mutex);
+			previous.swap(front);
+			front = std::move(published);
+		}
+		revision = current.snapshot->revision;
+		internal::get_registry().notify(notifier);
+		previous.reset();
+
+		// Catching up with more chunks than the array has costs more than a copy.
+		while (log.size() > (count + chunk_size - 1) / chunk_size) {
+			log_start = log.front().first;
+			log.pop_front();
+		}
+		// The most recent snapshot no reader holds has the least to catch up.
+		auto free_snapshot(retired.end());
+		for (auto snapshot = retired.begin(); snapshot != retired.end(); ++snapshot) {
+			if (snapshot->released->load(std::memory_order_acquire)
+					&& (free_snapshot == retired.end()
+						|| snapshot->snapshot->revision > free_snapshot->snapshot->revision)) {
+				free_snapshot = snapshot;
+			}
+		}
+		const snapshot_type &latest(*current.snapshot);
+		if (free_snapshot != retired.end()) {
+			back = std::move(free_snapshot->snapshot);
+			retired.erase(free_snapshot);
+			catch_up(latest);
+		} else {
+			back.reset(new snapshot_type(latest));
+		}
+	}
+
+	// Copies the chunks written since the revision of back from latest.
+	void catch_up(const snapshot_type &latest) {
+		if (back->revision < log_start) {
+			*back = latest;
+			return;
+		}
+		const auto first(std::upper_bound(log.begin(), log.end(), back->revision,
+			[](revision_type revision, const written_type &written) {
+			return revision < written.first;
+		}));
+		for (auto written = first; written != log.end(); ++written) {
+			if (written->second == all_chunks) {
+				*back = latest;
+				return;
+			}
+		}
+		for (auto written = first; written != log.end(); ++written) {
+			const std::size_t begin(written->second * chunk_size),
+				end(std::min(begin + chunk_size, count));
+			std::copy(latest.values.begin() + begin, latest.values.begin() + end,
+				back->values.begin() + begin);
+			back->dirty.mark(begin, count, written->first);
+		}
+		back->revision = latest.revision;
+	}
+
+	const std::size_t count;
+	mutable std::mutex front_mutex;
+	std::shared_ptr<const snapshot_type> front;
+	// Owned by the holder of writer_mutex.
+	std::unique_ptr<snapshot_type> back;
+	// The snapshot of front and the previous ones readers may still hold.
+	retired_type current;
+	std::vector<retired_type> retired;
+	// The chunks written after revision log_start, in revision order.
+	std::deque<written_type> log;
+	revision_type log_start;
+	std::mutex writer_mutex;
+	std::atomic<revision_type> revision;
+	std::shared_ptr<internal::notifier_type> notifier;
+};
+
+template<typename T>
+const std::size_t snapshot_storage_type<T>::chunk_size;
+template<typename T>
+const std::size_t snapshot_storage_type<T>::all_chunks;
+
+// Holds a snapshot, not a lock. Writers may publish newer revisions meanwhile.
+template<typename T>
+class readable_snapshot_type {
+	template<typename U>
+	friend readable_snapshot_type<U> read(const snapshot_storage_type<U> &storage);
+	template<typename U>
+	friend auto type::internal::get_revision(U &v)
+		->decltype(v.get_revision());
+	template<typename U>
+	friend auto type::internal::get_dirty(U &v)->decltype(v.get_dirty())&;
+
+	typedef internal::snapshot_type<T> snapshot_type;
+
+	explicit readable_snapshot_type(std::shared_ptr<const snapshot_type> &&snapshot)
+		: snapshot(std::move(snapshot)) {}
+
+public:
+	static const bool is_array = true;
+
+	typedef typename snapshot_storage_type<T>::const_iterator const_iterator;
+	typedef typename snapshot_storage_type<T>::size_type size_type;
+	typedef typename snapshot_storage_type<T>::value_type value_type;
+	typedef typename snapshot_storage_type<T>::const_reference const_reference;
+	typedef typename snapshot_storage_type<T>::const_pointer const_pointer;
+
+	readable_snapshot_type() = default;
+	readable_snapshot_type(const readable_snapshot_type &) = default;
+	readable_snapshot_type(readable_snapshot_type &&) = default;
+	readable_snapshot_type &operator=(const readable_snapshot_type &) = default;
+	readable_snapshot_type &operator=(readable_snapshot_type &&) = default;
+
+	const_iterator begin() const {
+		return snapshot->values.cbegin();
+	}
+
+	const_iterator end() const {
+		return snapshot->values.cend();
+	}
+
+	const_reference operator[] (std::size_t index) const {
+		return snapshot->values[index];
+	}
+
+	size_type size() const {
+		return snapshot->values.size();
+	}
+
+private:
+	const revision_type &get_revision() const {
+		return snapshot->revision;
+	}
+
+	const internal::dirty_type &get_dirty() const {
+		return snapshot->dirty;
+	}
+
+	std::shared_ptr<const snapshot_type> snapshot;
+};
+
+// Exclusive among writers, publishes a new revision when destroyed.
+template<typename T>
+class writable_snapshot_type {
+	template<typename U>
+	friend writable_snapshot_type<U> write(snapshot_storage_type<U> &storage);
+
+	typedef std::unique_lock<std::mutex> lock_type;
+
+	explicit writable_snapshot_type(snapshot_storage_type<T> &storage)
+		: lock(storage.writer_mutex), storage(&storage) {}
+
+public:
+	static const bool is_array = true;
+
+	typedef typename snapshot_storage_type<T>::iterator iterator;
+	typedef typename snapshot_storage_type<T>::size_type size_type;
+	typedef typename snapshot_storage_type<T>::value_type value_type;
+	typedef typename snapshot_storage_type<T>::reference reference;
+	typedef typename snapshot_storage_type<T>::pointer pointer;
+
+	writable_snapshot_type() : storage(nullptr) {}
+	writable_snapshot_type(const writable_snapshot_type &) = delete;
+	writable_snapshot_type(writable_snapshot_type &&copy)
+		: lock(std::move(copy.lock)), storage(copy.storage) {
+		copy.storage = nullptr;
+	}
+	writable_snapshot_type &operator=(const writable_snapshot_type &) = delete;
+	~writable_snapshot_type() {
+		if (storage) {
+			storage->publish();
+		}
+	}
+
+	// Iterators may write anywhere, so all elements are considered written.
+	iterator begin() const {
+		storage->mark_all();
+		return storage->back->values.begin();
+	}
+
+	iterator end() const {
+		storage->mark_all();
+		return storage->back->values.end();
+	}
+
+	reference operator[] (std::size_t index) const {
+		storage->mark(index);
+		return storage->back->values[index];
+	}
+
+	size_type size() const {
+		return storage->size();
+	}
+
+private:
+	lock_type lock;
+	snapshot_storage_type<T> *storage;
+};
+
+template<typename T>
+readable_snapshot_type<T> read(const snapshot_storage_type<T> &storage) {
+	return readable_snapshot_type<T>(storage.get_front());
+}
+
+template<typename T>
+writable_snapshot_type<T> write(snapshot_storage_type<T> &storage) {
+	return writable_snapshot_type<T>(storage);
+}
+
+template<typename T>
+using t_snapshot_array = snapshot_storage_type<T>;
+
+}  // namespace type
+
+#endif // GTYPE_SNAPSHOT_H_
@@ -16,8 +16,13 @@
 #ifndef GTYPE_ARRAY_TYPE_H_
 #define GTYPE_ARRAY_TYPE_H_
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
 #include <type/internal.h>
+#include <type/registry.h>
 #include <type/revision.h>
+#include <type/shared_mutex.h>
 #include <mutex>
 #include <vector>
 #include <iostream>
@@ -26,11 +31,94 @@ namespace type {
 
 namespace internal {
 
-template<typename T, bool Mutable, bool IsArray = true>
+// Records in which revision elements were last written, in chunks of
+// chunk_size elements, so readers can find what changed since a revision
+// they have seen. Chunks are only allocated once written through operator[].
+struct dirty_type {
+	static const std::size_t chunk_size = 32;
+
+	explicit dirty_type(revision_type all = REVISION_NONE) : all(all) {}
+
+	// Returns false if the chunk of index was already marked in revision.
+	bool mark(std::size_t index, std::size_t size, revision_type revision) {
+		if (chunks.empty()) {
+			chunks.resize((size + chunk_size - 1) / chunk_size, REVISION_NONE);
+		}
+		revision_type &chunk(chunks[index / chunk_size]);
+		const bool marked(chunk != revision);
+		chunk = revision;
+		return marked;
+	}
+
+	bool mark_all(revision_type revision) {
+		const bool marked(all != revision);
+		all = revision;
+		return marked;
+	}
+
+	// Calls functor(first, last) for each element range written after revision.
+	template<typename Functor>
+	void for_each(revision_type revision, std::size_t size, Functor functor) const {
+		if (revision == REVISION_NONE || all > revision) {
+			functor(std::size_t(0), size);
+			return;
+		}
+		for (std::size_t i = 0; i < chunks.size();) {
+			if (chunks[i] <= revision) {
+				++i;
+				continue;
+			}
+			const std::size_t first(i);
+			while (i < chunks.size() && chunks[i] > revision) {
+				++i;
+			}
+			functor(first * chunk_size, std::min(i * chunk_size, size));
+		}
+	}
+
+private:
+	std::vector<revision_type> chunks;
+	revision_type all;
+};
+
+// Calls functor(first, last) for the element ranges of v written after
+// revision. Containers without dirty tracking report all elements.
+template<typename T, typename Functor>
+auto for_each_dirty(T &v, revision_type revision, Functor functor, int)
+		->decltype(get_dirty(v), void()) {
+	get_dirty(v).for_each(revision, v.size(), functor);
+}
+
+template<typename T, typename Functor>
+void for_each_dirty(T &v, revision_type revision, Functor functor, long) {
+	functor(std::size_t(0), std::size_t(v.size()));
+}
+
+template<typename T, typename Functor>
+void for_each_dirty(T &v, revision_type revision, Functor functor) {
+	for_each_dirty(v, revision, functor, 0);
+}
+
+// What to read the revision and dirty chunks of values read from storage
+// from: values when it carries its own, such as a snapshot, otherwise storage.
+template<typename Storage, typename Values>
+auto get_view(Storage &storage, Values &values, int)->decltype(get_dirty(values), (values)) {
+	return values;
+}
+
+template<typename Storage, typename Values>
+Storage &get_view(Storage &storage, Values &values, long) {
+	return storage;
+}
+
+// Container is a std::vector<T> or an adapter with the same interface over
+// memory owned elsewhere, see external.h.
+template<typename T, bool Mutable, bool IsArray = true,
+	typename Container = std::vector<T>>
 class storage_type {
 	template<typename U>
 	friend auto type::internal::get_revision(U &v)
-		->decltype(v.get_revision())&;
+		->decltype(v.get_revision());
 
 	template<typename U>
 	friend auto type::internal::get_container(U &v)
@@ -39,9 +127,16 @@ class storage_type {
 	template<typename U>
 	friend auto type::internal::get_lock(U &v)->decltype(v.get_lock())&;
 
-	typedef std::vector<T> container_type;
+	template<typename U>
+	friend auto type::internal::get_dirty(U &v)->decltype(v.get_dirty())&;
+
+	template<typename U>
+	friend auto type::internal::get_notifier(U &v)->decltype(v.get_notifier())&;
+
+	typedef Container container_type;
 public:
-	typedef std::mutex mutex_type;
+	// Readers share the lock, writers hold it exclusively.
+	typedef shared_mutex_type mutex_type;
 	typedef std::unique_lock<mutex_type> lock_type;
 
 	static const bool is_array = IsArray;
@@ -56,18 +151,21 @@ public:
 	typedef typename container_type::const_pointer const_pointer;
 
 	explicit storage_type(std::size_t size, const T &value = T())
-		: array(size, value), revision(1) {}
+		: array(size, value), revision(1), dirty(revision),
+		  notifier(std::make_shared<notifier_type>()) {}
 
 	template<typename IteratorT>
 	storage_type(IteratorT begin, IteratorT end)
-		: array(begin, end), revision(1) {}
+		: array(begin, end), revision(1), dirty(revision),
+		  notifier(std::make_shared<notifier_type>()) {}
 
 	storage_type(std::initializer_list<value_type> &&initializer)
 		: array(std::forward<std::initializer_list<value_type>>(initializer)),
-		  revision(1) {}
+		  revision(1), dirty(revision),
+		  notifier(std::make_shared<notifier_type>()) {}
 
 	template<bool _Mutable, bool _IsArray>
-	storage_type(const storage_type<T, _Mutable, _IsArray> &c)
+	storage_type(const storage_type<T, _Mutable, _IsArray, Container> &c)
 		: storage_type(c.internal_copy()) {}
 
 	// Not thread-safe for obvious reasons.
@@ -75,16 +173,17 @@ public:
 	// which should be considered non thread-safe.
 	// Note: Old object will be in an invalid state (its size will be zero)
 	template<bool _Mutable, bool _IsArray>
-	storage_type(storage_type<T, _Mutable, _IsArray> &&c)
+	storage_type(storage_type<T, _Mutable, _IsArray, Container> &&c)
 		: array(std::move(internal::get_container(c))),
-		  revision(internal::get_revision(c)) {}
+		  revision(internal::get_revision(c).load()), dirty(revision),
+		  notifier(std::make_shared<notifier_type>()) {}
 
 	// Provided only since compiler fails to see above copy constructor even
 	// with _Mutable = Mutable.
 	// Note: Old object will be in an invalid state (its size will be zero)
-	storage_type(const storage_type<T, Mutable, IsArray> &c)
+	storage_type(const storage_type &c)
 		: storage_type(c.internal_copy()) {}
-	storage_type(storage_type<T, Mutable, IsArray> &&) = default;
+	storage_type(storage_type &&) = default;
 
 	size_type size() const {
 		return array.size();
@@ -94,16 +193,21 @@ protected:
 
 	explicit storage_type(std::tuple<container_type, revision_type> &&copy)
 		: array(std::forward<container_type>(std::get<0>(copy))),
-		  revision(std::get<1>(copy)) {}
+		  revision(std::get<1>(copy)), dirty(revision),
+		  notifier(std::make_shared<notifier_type>()) {}
 
 	std::tuple<container_type, revision_type> internal_copy() const {
-		std::lock_guard<std::mutex> lock(this->lock);
-		return std::make_tuple(array, revision);
+		shared_lock_type<shared_mutex_type> lock(this->lock);
+		return std::make_tuple(array, revision.load());
 	}
 
 	container_type array;
-	mutable std::mutex lock;
-	revision_type revision;
+	mutable shared_mutex_type lock;
+	// Written under the exclusive lock, but may be read without it.
+	std::atomic<revision_type> revision;
+	dirty_type dirty;
+	// Writers queue it in the registry, see registry.h.
+	std::shared_ptr<notifier_type> notifier;
 
 private:
 	container_type &get_container() {
@@ -114,13 +218,25 @@ private:
 		return array;
 	}
 
-	std::mutex &get_lock() const {
+	shared_mutex_type &get_lock() const {
 		return lock;
 	}
 
-	revision_type &get_revision() {
+	std::atomic<revision_type> &get_revision() {
 		return revision;
 	}
+
+	dirty_type &get_dirty() {
+		return dirty;
+	}
+
+	const dirty_type &get_dirty() const {
+		return dirty;
+	}
+
+	const std::shared_ptr<notifier_type> &get_notifier() const {
+		return notifier;
+	}
 };
 
 }  // end namespace internal
@@ -130,7 +246,7 @@ template<typename T, bool Mutable, bool IsArray> class storage_type;
 template<typename T, bool Mutable>
 class storage_type<T, Mutable, true>
 		: public internal::storage_type<T, Mutable, true> {
-	template<typename U, bool _IsArray>
+	template<typename U, bool _IsArray, typename _Container>
 	friend class writable_storage_type;
 
 public:
@@ -182,11 +298,12 @@ public:
 
 namespace internal {
 
-template<typename T, bool Mutable, bool IsArray>
+template<typename T, bool Mutable, bool IsArray,
+	typename Container = std::vector<T>>
 class readable_storage_type {
 protected:
-	typedef storage_type<T, Mutable, IsArray> target_type;
-	typedef std::unique_lock<std::mutex> lock_type;
+	typedef storage_type<T, Mutable, IsArray, Container> target_type;
+	typedef shared_lock_type<shared_mutex_type> lock_type;
 
 	readable_storage_type(const target_type &array, lock_type &&lock)
 		: lock(std::forward<lock_type>(lock)), array(&array) {}
@@ -204,12 +321,10 @@ public:
 	typedef typename target_type::const_pointer const_pointer;
 
 	readable_storage_type() : array(nullptr) {}
-	readable_storage_type(const readable_storage_type<T, Mutable, IsArray> &) = delete;
-	readable_storage_type(readable_storage_type<T, Mutable, IsArray> &&) = default;
-	readable_storage_type &operator=(
-		const readable_storage_type<T, Mutable, IsArray> &) = delete;
-	readable_storage_type &operator=(
-		readable_storage_type<T, Mutable, IsArray> &&copy) {
+	readable_storage_type(const readable_storage_type &) = delete;
+	readable_storage_type(readable_storage_type &&) = default;
+	readable_storage_type &operator=(const readable_storage_type &) = delete;
+	readable_storage_type &operator=(readable_storage_type &&copy) {
 		lock = std::move(copy.lock);
 		array = copy.array;
 		copy.array = nullptr;
@@ -228,6 +343,10 @@ public:
 		return internal::get_container(*array)[index];
 	}
 
+	const_pointer data() const {
+		return internal::get_container(*array).data();
+	}
+
 	size_type size() const {
 		return internal::get_container(*array).size();
 	}
@@ -345,7 +464,7 @@ template<typename T, bool Mutable, bool IsArray>
 readable_storage_type<T, Mutable, IsArray> read(
 	const storage_type<T, Mutable, IsArray> &array, std::defer_lock_t t) {
 	typedef readable_storage_type<T, Mutable, IsArray> readable_storage_t;
-	return readable_storage_t(array, readable_storage_t::lock_type(
+	return readable_storage_t(array, typename readable_storage_t::lock_type(
 		internal::get_lock(array), t));
 }
 
@@ -353,19 +472,20 @@ template<typename T, bool Mutable, bool IsArray>
 readable_storage_type<T, Mutable, IsArray> read(
 	const storage_type<T, Mutable, IsArray> &array, std::try_to_lock_t t) {
 	typedef readable_storage_type<T, Mutable, IsArray> readable_storage_t;
-	return readable_storage_t(array, readable_storage_t::lock_type(
+	return readable_storage_t(array, typename readable_storage_t::lock_type(
 		internal::get_lock(array), t));
 }
 
+// The lock of array must be held in shared mode.
 template<typename T, bool Mutable, bool IsArray>
 readable_storage_type<T, Mutable, IsArray> read(
 	const storage_type<T, Mutable, IsArray> &array, std::adopt_lock_t t) {
 	typedef readable_storage_type<T, Mutable, IsArray> readable_storage_t;
-	return readable_storage_t(array, readable_storage_t::lock_type(
+	return readable_storage_t(array, typename readable_storage_t::lock_type(
 		internal::get_lock(array), t));
 }
 
-template<typename T, bool IsArray>
+template<typename T, bool IsArray, typename Container = std::vector<T>>
 class writable_storage_type {
 	template<typename U, bool _IsArray>
 	friend writable_storage_type<U, _IsArray> write(
@@ -379,9 +499,9 @@ class writable_storage_type {
 	template<typename U, bool _IsArray>
 	friend writable_storage_type<U, _IsArray> write(
 		storage_type<U, true, _IsArray> &array, std::adopt_lock_t);
-private:
-	typedef storage_type<T, true, IsArray> target_type;
-	typedef std::unique_lock<std::mutex> lock_type;
+protected:
+	typedef internal::storage_type<T, true, IsArray, Container> target_type;
+	typedef std::unique_lock<shared_mutex_type> lock_type;
 
 	writable_storage_type(target_type &array, lock_type &&lock)
 		: lock(std::forward<lock_type>(lock)), array(&array) {}
@@ -399,12 +519,10 @@ public:
 	typedef typename target_type::pointer pointer;
 
 	writable_storage_type() : array(nullptr) {}
-	writable_storage_type(const writable_storage_type<T, IsArray> &) = delete;
-	writable_storage_type(writable_storage_type<T, IsArray> &&) = default;
-	writable_storage_type &operator=(
-		const writable_storage_type<T, IsArray> &) = delete;
-	writable_storage_type &operator=(
-			writable_storage_type<T, IsArray> &&copy) {
+	writable_storage_type(const writable_storage_type &) = delete;
+	writable_storage_type(writable_storage_type &&) = default;
+	writable_storage_type &operator=(const writable_storage_type &) = delete;
+	writable_storage_type &operator=(writable_storage_type &&copy) {
 		lock = std::move(copy.lock);
 		array = copy.array;
 		copy.array = nullptr;
@@ -413,18 +531,26 @@ public:
 	~writable_storage_type() {
 		if (array) {
 			++internal::get_revision(*array);
+			internal::get_registry().notify(internal::get_notifier(*array));
 		}
 	}
 
+	// Iterators may write anywhere, so all elements are considered written.
 	iterator begin() const {
+		internal::get_dirty(*array).mark_all(internal::get_revision(*array) + 1);
 		return internal::get_container(*array).begin();
 	}
 
 	iterator end() const {
+		internal::get_dirty(*array).mark_all(internal::get_revision(*array) + 1);
 		return internal::get_container(*array).end();
 	}
 
+	// The revision is incremented once this is destroyed,
+	// so elements are marked as written in the next revision.
 	reference operator[] (std::size_t index) const {
+		internal::get_dirty(*array).mark(index, size(),
+			internal::get_revision(*array) + 1);
 		return internal::get_container(*array)[index];
 	}
 
@@ -449,7 +575,7 @@ template<typename T, bool IsArray>
 writable_storage_type<T, IsArray> write(
 	storage_type<T, true, IsArray> &array, std::defer_lock_t t) {
 	typedef writable_storage_type<T, IsArray> writable_storage_t;
-	return writable_storage_t(array, writable_storage_t::lock_type(
+	return writable_storage_t(array, typename writable_storage_t::lock_type(
 		internal::get_lock(array), t));
 }
 
@@ -457,7 +583,7 @@ template<typename T, bool IsArray>
 writable_storage_type<T, IsArray> write(
 	storage_type<T, true, IsArray> &array, std::try_to_lock_t t) {
 	typedef writable_storage_type<T, IsArray> writable_storage_t;
-	return writable_storage_t(array, writable_storage_t::lock_type(
+	return writable_storage_t(array, typename writable_storage_t::lock_type(
 		internal::get_lock(array), t));
 }
 
@@ -465,7 +591,7 @@ template<typename T, bool IsArray>
 writable_storage_type<T, IsArray> write(
 	storage_type<T, true, IsArray> &array, std::adopt_lock_t t) {
 	typedef writable_storage_type<T, IsArray> writable_storage_t;
-	return writable_storage_t(array, writable_storage_t::lock_type(
+	return writable_storage_t(array, typename writable_storage_t::lock_type(
 		internal::get_lock(array), t));
 }
 
@@ -489,6 +615,7 @@ using writable_t_array = writable_storage_type<T, true>;
 template<typename T>
 using writable_t_primitive = writable_storage_type<T, false>;
 
+// Locks the storages exclusively without deadlocking, to be adopted by write.
 template<typename StorageType1, typename StorageType2,
 	typename... StorageTypeN>
 void lock(StorageType1 &storage1, StorageType2 &storage2,
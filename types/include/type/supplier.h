@@ -93,6 +93,11 @@ public:
 		return !!pointer;
 	}
 
+	// False for suppliers of a reference, which do not keep the value alive.
+	bool owner() const {
+		return !!shared_reference;
+	}
+
 	template<typename... Args>
 	auto operator() (Args... values) const
 			->decltype(std::declval<T&>()(std::forward<Args>(values)...)) {
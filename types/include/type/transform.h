@@ -19,13 +19,67 @@
 #include <algorithm>
 #include <array>
 #include <functional>
+#include <numeric>
+#include <type_traits>
+#include <vector>
+#include <type/executor.h>
 #include <type/storage.h>
 #include <type/supplier.h>
 
 namespace type {
 
+// Elements [first, last) of an array.
+struct index_range_type {
+	std::size_t first, last;
+};
+
+template<typename T, bool IsArray>
+class transform_type;
+
+// Declared ahead so transforms can read other transforms.
+template<typename T, bool IsArray>
+readable_storage_type<T, true, IsArray> read(const transform_type<T, IsArray> &array);
+
 namespace internal {
 
+// What evaluate needs to know about a transform_type.
+struct transform_node_type {
+	virtual ~transform_node_type() {}
+	// Runs the functor if any input changed since the last flush.
+	virtual void flush() const = 0;
+	// Appends the inputs that are transforms themselves.
+	virtual void inputs(std::vector<const transform_node_type *> &inputs) const = 0;
+};
+
+inline void append_input(const transform_node_type &input,
+		std::vector<const transform_node_type *> &inputs) {
+	inputs.push_back(&input);
+}
+
+template<typename T>
+typename std::enable_if<!std::is_base_of<transform_node_type, T>::value>::type
+append_input(const T &, std::vector<const transform_node_type *> &) {}
+
+template<std::size_t I>
+struct transform_inputs_type {
+	template<typename Container>
+	static void inputs(const Container &container,
+			std::vector<const transform_node_type *> &inputs) {
+		transform_inputs_type<I - 1>::inputs(container, inputs);
+		append_input(*std::get<I - 1>(container), inputs);
+	}
+};
+
+template<>
+struct transform_inputs_type<0> {
+	template<typename Container>
+	static void inputs(const Container &, std::vector<const transform_node_type *> &) {}
+};
+
+// Flushes transforms and the transforms they read, see type::evaluate.
+void evaluate(const std::vector<const transform_node_type *> &transforms,
+	const executor_type &executor);
+
 template<std::size_t I>
 struct transform_get_revisions_type {
 	template<typename Container>
@@ -64,20 +118,97 @@ struct transform_read_type<0> {
 	}
 };
 
+// Sorts ranges and merges the ones overlapping or touching.
+inline void merge(std::vector<index_range_type> &ranges) {
+	std::sort(ranges.begin(), ranges.end(),
+		[](const index_range_type &a, const index_range_type &b) {
+		return a.first < b.first;
+	});
+	std::size_t merged(0);
+	for (std::size_t i = 1; i < ranges.size(); ++i) {
+		if (ranges[i].first <= ranges[merged].last) {
+			ranges[merged].last = std::max(ranges[merged].last, ranges[i].last);
+		} else {
+			ranges[++merged] = ranges[i];
+		}
+	}
+	if (!ranges.empty()) {
+		ranges.resize(merged + 1);
+	}
+}
+
+// As transform_read_type, also passing the element ranges of the inputs
+// written since revisions. Inputs without dirty tracking, such as another
+// transform, report all of their elements.
+template<std::size_t I>
+struct transform_incremental_read_type {
+	template<typename Functor, typename Storage, typename Container, typename Revisions,
+		typename... Readers>
+	static void read(Functor &functor, Storage &&storage, Container &container,
+			const Revisions &revisions, std::vector<index_range_type> &ranges,
+			Readers&&... readers) {
+		auto &input(*std::get<I - 1>(container));
+		auto reader(type::read(input));
+		for_each_dirty(get_view(input, reader, 0), std::get<I - 1>(revisions),
+			[&ranges](std::size_t first, std::size_t last) {
+			ranges.push_back(index_range_type{ first, last });
+		});
+		transform_incremental_read_type<I - 1>::read(functor, std::forward<Storage>(storage),
+			container, revisions, ranges, std::move(reader), std::forward<Readers>(readers)...);
+	}
+};
+
+template<>
+struct transform_incremental_read_type<0> {
+	template<typename Functor, typename Storage, typename Container, typename Revisions,
+		typename... Readers>
+	static void read(Functor &functor, Storage &&storage, Container &container,
+			const Revisions &revisions, std::vector<index_range_type> &ranges,
+			Readers&&... readers) {
+		merge(ranges);
+		functor(static_cast<const std::vector<index_range_type> &>(ranges),
+			static_cast<const Readers &>(readers)..., std::forward<Storage>(storage));
+	}
+};
+
+// How template_transform_type_impl calls its functor.
+struct transform_call_type {
+	template<typename Functor, typename Storage, typename Container, typename Revisions>
+	static void call(Functor &functor, Storage &&storage, Container &container,
+			const Revisions &revisions) {
+		transform_read_type<std::tuple_size<Container>::value>::read(functor,
+			std::forward<Storage>(storage), container);
+	}
+};
+
+// Passes the functor the changed ranges as well, see make_incremental_transform.
+struct transform_incremental_call_type {
+	template<typename Functor, typename Storage, typename Container, typename Revisions>
+	static void call(Functor &functor, Storage &&storage, Container &container,
+			const Revisions &revisions) {
+		std::vector<index_range_type> ranges;
+		transform_incremental_read_type<std::tuple_size<Container>::value>::read(functor,
+			std::forward<Storage>(storage), container, revisions, ranges);
+	}
+};
+
+struct incremental_tag {};
+
 template<typename T, bool IsArray>
 struct transform_type_impl {
 	typedef writable_storage_type<T, IsArray> internal_writable_storage_type;
 	virtual void update(internal_writable_storage_type &&) = 0;
-	virtual revision_type &get_revision() = 0;
+	virtual revision_type get_revision() const = 0;
+	virtual void inputs(std::vector<const transform_node_type *> &inputs) const = 0;
 };
 
-template<typename T, bool IsArray, typename Functor, typename... Containers>
+template<typename T, bool IsArray, typename Call, typename Functor, typename... Containers>
 struct template_transform_type_impl : transform_type_impl<T, IsArray> {
 	typedef writable_storage_type<T, IsArray> internal_writable_storage_type;
 	typedef std::array<revision_type, sizeof...(Containers)> revisions_type;
 
 	template_transform_type_impl(Functor functor, const supplier<Containers> &... container)
-			: functor(std::forward<Functor>(functor)), revision(1)
+			: functor(std::forward<Functor>(functor))
 			, container(std::make_tuple(container...)) {
 		std::fill(std::begin(revisions), std::end(revisions), REVISION_NONE);
 	}
@@ -86,28 +217,35 @@ struct template_transform_type_impl : transform_type_impl<T, IsArray> {
 		// storage is locked in the scope of this function.
 		revisions_type current_revisions(
 			transform_get_revisions_type<sizeof...(Containers)>::get_revisions(container));
-		if (current_revisions > revisions) {
-			transform_read_type<sizeof...(Containers)>::read(functor,
-				std::forward<internal_writable_storage_type>(storage), container);
+		if (current_revisions != revisions) {
+			Call::call(functor, std::forward<internal_writable_storage_type>(storage),
+				container, revisions);
 			revisions = current_revisions;
 		}
 	}
-	revision_type &get_revision() override {
-		revisions_type current_revisions(
+
+	// The sum of the input revisions, which only grow, so it changes whenever
+	// any input does. Lock-free since it only reads the input revisions.
+	revision_type get_revision() const override {
+		const revisions_type current_revisions(
 			transform_get_revisions_type<sizeof...(Containers)>::get_revisions(container));
-		return current_revisions > revisions ? ++revision : revision;
+		return std::accumulate(std::begin(current_revisions), std::end(current_revisions),
+			revision_type(1));
+	}
+
+	void inputs(std::vector<const transform_node_type *> &inputs) const override {
+		transform_inputs_type<sizeof...(Containers)>::inputs(container, inputs);
 	}
 
 	Functor functor;
 	revisions_type revisions;
-	revision_type revision;
 	const std::tuple<supplier<Containers>...> container;
 };
 
 } // namespace internal
 
 template<typename T, bool IsArray>
-class transform_type {
+class transform_type : public internal::transform_node_type {
 private:
 	typedef storage_type<T, true, IsArray> internal_storage_type;
 	typedef writable_storage_type<T, IsArray> internal_writable_storage_type;
@@ -115,7 +253,7 @@ private:
 
 	template<typename U>
 	friend auto type::internal::get_revision(U &v)
-		->decltype(v.get_revision())&;
+		->decltype(v.get_revision());
 	template<typename U, bool IsArray_>
 	friend readable_storage_type<U, true, IsArray_> read(const transform_type<U, IsArray_> &);
 
@@ -134,7 +272,16 @@ public:
 	template<typename... Containers, typename Functor>
 	transform_type(internal_storage_type &&storage,
 			Functor functor, const supplier<Containers> &... container)
-		: impl(new internal::template_transform_type_impl<T, IsArray, Functor, Containers...>(
+		: impl(new internal::template_transform_type_impl<T, IsArray,
+			internal::transform_call_type, Functor, Containers...>(
+			std::forward<Functor>(functor), container...)),
+		  storage(std::forward<internal_storage_type>(storage)) {}
+
+	template<typename... Containers, typename Functor>
+	transform_type(internal::incremental_tag, internal_storage_type &&storage,
+			Functor functor, const supplier<Containers> &... container)
+		: impl(new internal::template_transform_type_impl<T, IsArray,
+			internal::transform_incremental_call_type, Functor, Containers...>(
 			std::forward<Functor>(functor), container...)),
 		  storage(std::forward<internal_storage_type>(storage)) {}
 
@@ -143,11 +290,15 @@ public:
 	}
 
 private:
-	void flush() const {
+	void flush() const override {
 		impl->update(write(storage));
 	}
 
-	revision_type &get_revision() {
+	void inputs(std::vector<const internal::transform_node_type *> &inputs) const override {
+		impl->inputs(inputs);
+	}
+
+	revision_type get_revision() const {
 		return impl->get_revision();
 	}
 
@@ -173,6 +324,19 @@ readable_storage_type<T, true, IsArray> read(const transform_type<T, IsArray> &a
 	return read(array.storage);
 }
 
+// Flushes the given transforms and the transforms they read, directly or not,
+// so reading them afterwards does not run any functor. Each transform is
+// flushed by a task on executor once the transforms it reads are, so
+// independent transforms run in parallel. Returns once all have run,
+// rethrowing the first exception of a functor or of executor. Transforms not
+// yet handed to executor by then are left unflushed.
+// executor is called from the tasks as well and must be thread-safe.
+template<typename... Transforms>
+void evaluate(const executor_type &executor, const Transforms &... transforms) {
+	internal::evaluate(std::vector<const internal::transform_node_type *>{ &transforms... },
+		executor);
+}
+
 template<typename Storage, typename... Containers, typename FunctorT>
 auto make_transform(Storage &&storage, FunctorT functor, Containers... container)
 		->transform_type<typename Storage::value_type, Storage::is_array> {
@@ -181,6 +345,20 @@ auto make_transform(Storage &&storage, FunctorT functor, Containers... container
 		make_supplier(std::forward<Containers>(container))...);
 }
 
+// As make_transform, but functor is called as
+// functor(changed, readers..., output) where changed are the sorted, merged
+// element ranges of the inputs written since the previous call, everything
+// on the first. output keeps its content from the previous call, so only
+// the elements depending on changed need to be written.
+template<typename Storage, typename... Containers, typename FunctorT>
+auto make_incremental_transform(Storage &&storage, FunctorT functor, Containers... container)
+		->transform_type<typename Storage::value_type, Storage::is_array> {
+	return transform_type<typename Storage::value_type, Storage::is_array>(
+		internal::incremental_tag(), std::forward<Storage>(storage),
+		std::forward<FunctorT>(functor),
+		make_supplier(std::forward<Containers>(container))...);
+}
+
 }  // namespace type
 
 #endif // TYPE_TRANSFORM_H_
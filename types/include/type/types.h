@@ -219,6 +219,15 @@ constexpr const T& constexpr_max(const T& a, const T& b) {
 template<memory_layout layout, typename T>
 struct primitive_type_information;
 
+// True if T is serialized as the first primitive_type_information::size bytes
+// of its object representation, so copying it is a memcpy.
+template<memory_layout layout, typename T, typename Enable = void>
+struct is_bitwise : std::false_type {};
+
+template<memory_layout layout, typename T>
+struct is_bitwise<layout, T, typename std::enable_if<
+	primitive_type_information<layout, T>::bitwise>::type> : std::true_type {};
+
 template<memory_layout layout>
 struct alignment_type {
 
@@ -295,6 +304,7 @@ struct primitive_type_information
 template<typename T> struct primitive_primitive_type_information {
 
 	constexpr static std::size_t size = sizeof(T), alignment = sizeof(T), array_size = size;
+	constexpr static bool bitwise = true;
 
 	static void copy(const T &value, void *target) {
 		*reinterpret_cast<T *>(target) = value;
@@ -326,6 +336,7 @@ template<typename T, std::size_t Size, std::size_t Alignment = Size>
 struct glm_vec_type_information {
 
 	constexpr static std::size_t size = Size, alignment = Alignment, array_size = alignment;
+	constexpr static bool bitwise = Size == sizeof(T);
 
 	static void copy(const T &value, void *target) {
 		std::memcpy(target, glm::value_ptr(value), size);
@@ -367,6 +378,8 @@ struct primitive_type_information<layout, std::array<T, Size>> {
 	constexpr static std::size_t alignment = layout == linear_std140 || layout == interleaved_std140
 		? constexpr_max(primitive_alignment, sizeof(float) * 4) : primitive_alignment,
 		size = Size * alignment, array_size = size;
+	constexpr static bool bitwise = is_bitwise<layout, T>::value
+		&& alignment == sizeof(T) && size == sizeof(std::array<T, Size>);
 
 	static void copy(const std::array<T, Size> &value, void *target) {
 		uint8_t *bytes(reinterpret_cast<uint8_t *>(target));
@@ -460,6 +473,8 @@ template<typename T, std::size_t Size, std::size_t Alignment, std::size_t Column
 struct glm_mat_type_information {
 
 	constexpr static std::size_t size = Columns * Alignment, alignment = Alignment, array_size = size;
+	// Columns are padded to the alignment, bitwise only without padding.
+	constexpr static bool bitwise = Size == Alignment && size == sizeof(T);
 
 	static void copy(const T &value, void *target) {
 		uint8_t *bytes(reinterpret_cast<uint8_t *>(target));
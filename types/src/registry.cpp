@@ -0,0 +1,109 @@
+/*
+* Copyright 2016 Google Inc. All Rights Reserved.
+
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+
+* http://www.apache.org/licenses/LICENSE-2.0
+
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include <algorithm>
+#include <type/registry.h>
+
+namespace type {
+namespace internal {
+
+void subscribe(notifier_type &notifier, const std::shared_ptr<std::atomic<bool>> &changed) {
+	std::lock_guard<std::mutex> lock(notifier.mutex);
+	notifier.subscribers.erase(std::remove_if(notifier.subscribers.begin(),
+		notifier.subscribers.end(), [](const std::weak_ptr<std::atomic<bool>> &subscriber) {
+		return subscriber.expired();
+	}), notifier.subscribers.end());
+	notifier.subscribers.push_back(changed);
+	notifier.subscribed = true;
+}
+
+registry_type::~registry_type() {
+	node_type *node(head.exchange(nullptr));
+	while (node) {
+		node_type *next(node->next);
+		delete node;
+		node = next;
+	}
+}
+
+void registry_type::notify(const std::shared_ptr<notifier_type> &notifier) {
+	if (!notifier->subscribed || notifier->queued.exchange(true)) {
+		return;
+	}
+	node_type *node(new node_type{ notifier, head.load() });
+	while (!head.compare_exchange_weak(node->next, node)) {}
+}
+
+std::size_t registry_type::collect() {
+	// A notification is either still in the list or taken by a collect
+	// that has not returned yet, in which case this one waits for it.
+	if (!head.load() && !collecting.load()) {
+		return 0;
+	}
+	std::lock_guard<std::mutex> lock(mutex);
+	++collecting;
+	node_type *node(head.exchange(nullptr));
+	std::size_t count(0);
+	while (node) {
+		if (const std::shared_ptr<notifier_type> notifier = node->notifier.lock()) {
+			// Cleared first, a write after this is queued again.
+			notifier->queued = false;
+			std::lock_guard<std::mutex> notifier_lock(notifier->mutex);
+			for (const std::weak_ptr<std::atomic<bool>> &subscriber : notifier->subscribers) {
+				if (const std::shared_ptr<std::atomic<bool>> changed = subscriber.lock()) {
+					*changed = true;
+				}
+			}
+			++count;
+		}
+		node_type *next(node->next);
+		delete node;
+		node = next;
+	}
+	--collecting;
+	return count;
+}
+
+registry_type &get_registry() {
+	// Never destroyed, storages with static storage duration may outlive it.
+	static registry_type *registry(new registry_type);
+	return *registry;
+}
+
+namespace {
+
+// Number of collect_batch_type alive on the thread.
+thread_local std::size_t batch_depth(0);
+
+}  // anonymous namespace
+
+void collect_unless_batched() {
+	if (!batch_depth) {
+		get_registry().collect();
+	}
+}
+
+collect_batch_type::collect_batch_type() {
+	if (!batch_depth++) {
+		get_registry().collect();
+	}
+}
+
+collect_batch_type::~collect_batch_type() {
+	--batch_depth;
+}
+
+}  // namespace internal
+}  // namespace type
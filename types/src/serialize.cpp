@@ -14,8 +14,80 @@
 * limitations under the License.
 */
 #include <algorithm>
+#include <exception>
 #include <type/serialize.h>
 
 namespace type {
+namespace internal {
 
+parallel_type::~parallel_type() {
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this]() { return !pending; });
+}
+
+void parallel_type::add(std::function<void()> &&task, std::size_t bytes) {
+	batch.push_back(std::move(task));
+	batch_bytes += bytes;
+	if (batch_bytes >= grain) {
+		submit();
+	}
+}
+
+void parallel_type::submit() {
+	std::shared_ptr<std::vector<std::function<void()>>> tasks(
+		std::make_shared<std::vector<std::function<void()>>>());
+	tasks->swap(batch);
+	batch_bytes = 0;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		++pending;
+	}
+	try {
+		executor([this, tasks]() {
+			std::exception_ptr task_exception;
+			try {
+				for (const std::function<void()> &task : *tasks) {
+					task();
+				}
+			} catch (...) {
+				task_exception = std::current_exception();
+			}
+			finish(task_exception);
+		});
+	} catch (...) {
+		// The task was not handed over, it is not waited for.
+		finish(std::exception_ptr());
+		throw;
+	}
+}
+
+void parallel_type::finish(const std::exception_ptr &task_exception) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (task_exception && !exception) {
+		exception = task_exception;
+	}
+	if (!--pending) {
+		done.notify_all();
+	}
+}
+
+void parallel_type::wait() {
+	for (const std::function<void()> &task : batch) {
+		task();
+	}
+	batch.clear();
+	batch_bytes = 0;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this]() { return !pending; });
+	}
+	kept.clear();
+	if (exception) {
+		std::exception_ptr rethrown;
+		rethrown.swap(exception);
+		std::rethrow_exception(rethrown);
+	}
+}
+
+}  // namespace internal
 }  // namespace type
@@ -0,0 +1,145 @@
+/*
+* Copyright 2016 Google Inc. All Rights Reserved.
+
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+
+* http://www.apache.org/licenses/LICENSE-2.0
+
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <unordered_map>
+#include <type/transform.h>
+
+namespace type {
+namespace internal {
+
+namespace {
+
+struct node_type {
+	const transform_node_type *transform;
+	// Inputs not flushed yet.
+	std::size_t pending;
+	std::vector<std::size_t> dependents;
+};
+
+struct graph_type {
+	explicit graph_type(const executor_type &executor) : executor(executor), remaining(0) {}
+
+	// Adds transform and its inputs, returns the index of its node.
+	std::size_t add(const transform_node_type *transform) {
+		const auto found(indices.find(transform));
+		if (found != indices.end()) {
+			return found->second;
+		}
+		std::vector<const transform_node_type *> inputs;
+		transform->inputs(inputs);
+		const std::size_t index(nodes.size());
+		indices.emplace(transform, index);
+		nodes.push_back(node_type{ transform, 0, std::vector<std::size_t>() });
+		for (const transform_node_type *input : inputs) {
+			const std::size_t input_index(add(input));
+			nodes[input_index].dependents.push_back(index);
+			++nodes[index].pending;
+		}
+		return index;
+	}
+
+	// Hands the node to the executor, or completes it without flushing once
+	// something failed, so every node is completed exactly once.
+	void run(std::size_t index) {
+		bool failed;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			failed = bool(exception);
+		}
+		if (!failed) {
+			try {
+				executor([this, index]() {
+					try {
+						nodes[index].transform->flush();
+					} catch (...) {
+						fail();
+					}
+					complete(index);
+				});
+				return;
+			} catch (...) {
+				fail();
+			}
+		}
+		complete(index);
+	}
+
+	void fail() {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!exception) {
+			exception = std::current_exception();
+		}
+	}
+
+	// Runs the dependents whose inputs are all done.
+	void complete(std::size_t index) {
+		std::vector<std::size_t> ready;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (std::size_t dependent : nodes[index].dependents) {
+				if (!--nodes[dependent].pending) {
+					ready.push_back(dependent);
+				}
+			}
+		}
+		for (std::size_t dependent : ready) {
+			run(dependent);
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!--remaining) {
+			done.notify_all();
+		}
+	}
+
+	const executor_type &executor;
+	std::unordered_map<const transform_node_type *, std::size_t> indices;
+	std::vector<node_type> nodes;
+	std::mutex mutex;
+	std::condition_variable done;
+	std::size_t remaining;
+	std::exception_ptr exception;
+};
+
+}  // anonymous namespace
+
+void evaluate(const std::vector<const transform_node_type *> &transforms,
+		const executor_type &executor) {
+	graph_type graph(executor);
+	for (const transform_node_type *transform : transforms) {
+		graph.add(transform);
+	}
+	graph.remaining = graph.nodes.size();
+	// Collected first, tasks complete and schedule dependents concurrently.
+	std::vector<std::size_t> sources;
+	for (std::size_t i = 0; i < graph.nodes.size(); ++i) {
+		if (!graph.nodes[i].pending) {
+			sources.push_back(i);
+		}
+	}
+	for (std::size_t source : sources) {
+		graph.run(source);
+	}
+	std::unique_lock<std::mutex> lock(graph.mutex);
+	graph.done.wait(lock, [&graph]() { return !graph.remaining; });
+	if (graph.exception) {
+		std::rethrow_exception(graph.exception);
+	}
+}
+
+}  // namespace internal
+}  // namespace type
@@ -0,0 +1,156 @@
+/*
+* Copyright 2016 Google Inc. All Rights Reserved.
+
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+
+* http://www.apache.org/licenses/LICENSE-2.0
+
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include <atomic>
+#include <cstdlib>
+#include <gtest/gtest.h>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <vcc/buffer.h>
+#include <vcc/command.h>
+#include <vcc/command_pool.h>
+#include <vcc/device.h>
+#include <vcc/internal/hook.h>
+#include <vcc/memory.h>
+#include <vcc/queue.h>
+#include "device_fixture.h"
+
+namespace {
+
+std::atomic<std::size_t> allocations(0);
+
+}  // anonymous namespace
+
+// Counts the heap allocations of the whole binary, built from this file
+// alone so the replacement does not affect the other tests.
+void *operator new(std::size_t size) {
+	++allocations;
+	if (void *pointer = std::malloc(size ? size : 1)) {
+		return pointer;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void *pointer) noexcept {
+	std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept {
+	std::free(pointer);
+}
+
+void *operator new[](std::size_t size) {
+	++allocations;
+	if (void *pointer = std::malloc(size ? size : 1)) {
+		return pointer;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete[](void *pointer) noexcept {
+	std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::size_t) noexcept {
+	std::free(pointer);
+}
+
+namespace {
+
+const std::size_t draw_count(5000);
+
+struct value_type {
+	int value;
+};
+
+}  // anonymous namespace
+
+// Refilling cleared containers with the references and hooks of a recording
+// allocates nothing, and repeated references are kept once.
+TEST(CommandAllocationBenchmarkTest, Containers) {
+	std::vector<std::shared_ptr<value_type>> values;
+	for (int i = 0; i < 64; ++i) {
+		values.push_back(std::make_shared<value_type>(value_type{ i }));
+	}
+	vcc::internal::reference_container_type references;
+	vcc::internal::hook_container_type<int &> hooks;
+	for (int recording = 0; recording < 2; ++recording) {
+		const std::size_t before(allocations);
+		for (std::size_t i = 0; i < draw_count; ++i) {
+			const type::supplier<const value_type> value(values[i % values.size()]);
+			references.add(value);
+			hooks.add([value](int &sum) { sum += value->value; });
+		}
+		const std::size_t recorded(allocations - before);
+		std::cout << "recording " << recording << ": "
+			<< double(recorded) / draw_count << " allocations per draw" << std::endl;
+		if (recording) {
+			EXPECT_EQ(0u, recorded);
+		}
+		int sum(0), expected(0);
+		hooks(sum);
+		for (std::size_t i = 0; i < draw_count; ++i) {
+			expected += values[i % values.size()]->value;
+		}
+		EXPECT_EQ(expected, sum);
+		references.clear();
+		hooks.clear();
+	}
+	for (const std::shared_ptr<value_type> &value : values) {
+		EXPECT_EQ(1, value.use_count());
+	}
+}
+
+// Records a fill_buffer per draw referencing the same buffer, twice into the
+// same command buffer, and prints the allocations per draw of each recording.
+TEST(CommandAllocationBenchmarkTest, Record) {
+	test::device_fixture_type fixture;
+	vcc::device::device_type &device(fixture.device);
+	vcc::queue::queue_type &queue(fixture.queue);
+
+	const std::shared_ptr<vcc::buffer::buffer_type> buffer(
+		std::make_shared<vcc::buffer::buffer_type>(vcc::buffer::create(std::ref(device), 0,
+			draw_count * sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_SHARING_MODE_EXCLUSIVE, {})));
+	const type::supplier<const vcc::memory::memory_type> memory(vcc::memory::bind(
+		std::ref(device), VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, *buffer));
+	vcc::command_pool::command_pool_type cmd_pool(vcc::command_pool::create(
+		std::ref(device), VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+		vcc::queue::get_family_index(queue)));
+	vcc::command_buffer::command_buffer_type command_buffer(std::move(
+		vcc::command_buffer::allocate(std::ref(device), std::ref(cmd_pool),
+			VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1).front()));
+
+	const type::supplier<const vcc::buffer::buffer_type> dst_buffer(buffer);
+	for (int recording = 0; recording < 2; ++recording) {
+		const std::size_t before(allocations);
+		{
+			vcc::command::build_type build(vcc::command::build(std::ref(command_buffer),
+				0, VK_FALSE, 0, 0));
+			for (std::size_t i = 0; i < draw_count; ++i) {
+				vcc::command::compile(build, vcc::command::fill_buffer{
+					dst_buffer, i * sizeof(uint32_t), sizeof(uint32_t), uint32_t(i) });
+			}
+		}
+		const std::size_t recorded(allocations - before);
+		std::cout << "recording " << recording << ": "
+			<< double(recorded) / draw_count << " allocations per draw" << std::endl;
+		// Driver allocations through operator new are counted too.
+		EXPECT_LT(double(recorded) / draw_count, 1.);
+	}
+	// The buffer is referenced once by the command buffer.
+	EXPECT_EQ(3, buffer.use_count());
+}
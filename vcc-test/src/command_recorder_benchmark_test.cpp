@@ -0,0 +1,90 @@
+/*
+* Copyright 2016 Google Inc. All Rights Reserved.
+
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+
+* http://www.apache.org/licenses/LICENSE-2.0
+
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#define NOMINMAX
+#include <chrono>
+#include <functional>
+#include <gtest/gtest.h>
+#include <iostream>
+#include <vcc/buffer.h>
+#include <vcc/command.h>
+#include <vcc/command_pool.h>
+#include <vcc/command_recorder.h>
+#include <vcc/device.h>
+#include <vcc/fence.h>
+#include <vcc/memory.h>
+#include <vcc/queue.h>
+#include "device_fixture.h"
+#include "thread_pool.h"
+
+// Records a fill_buffer per item of a draw list into secondaries on 1 to 8
+// threads, executes them from a primary and prints the recording time.
+TEST(CommandRecorderBenchmarkTest, Scaling) {
+	test::device_fixture_type fixture;
+	vcc::device::device_type &device(fixture.device);
+	vcc::queue::queue_type &queue(fixture.queue);
+
+	const std::size_t count(1 << 16), chunk_size(1 << 10);
+	vcc::buffer::buffer_type buffer(vcc::buffer::create(std::ref(device), 0,
+		count * sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_SHARING_MODE_EXCLUSIVE, {}));
+	const type::supplier<const vcc::memory::memory_type> memory(vcc::memory::bind(
+		std::ref(device), VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+			| VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer));
+
+	vcc::command_recorder::command_recorder_type recorder(vcc::command_recorder::create(
+		std::ref(device), vcc::queue::get_family_index(queue)));
+	vcc::command_pool::command_pool_type cmd_pool(vcc::command_pool::create(
+		std::ref(device), 0, vcc::queue::get_family_index(queue)));
+	const auto fill([&](vcc::command::build_type &build, std::size_t first, std::size_t last) {
+		for (std::size_t i = first; i < last; ++i) {
+			vcc::command::compile(build, vcc::command::fill_buffer{
+				type::make_supplier<const vcc::buffer::buffer_type>(buffer),
+				i * sizeof(uint32_t), sizeof(uint32_t), uint32_t(i) });
+		}
+	});
+
+	for (std::size_t threads = 1; threads <= 8; threads *= 2) {
+		test::thread_pool_type pool(threads);
+		const type::executor_type executor(std::ref(pool));
+		const auto start(std::chrono::steady_clock::now());
+		vcc::command::execute_commands commands(vcc::command_recorder::record(recorder,
+			executor, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, count, chunk_size, fill));
+		const std::chrono::duration<double, std::milli> elapsed(
+			std::chrono::steady_clock::now() - start);
+		std::cout << threads << " threads: recorded " << count << " commands in "
+			<< elapsed.count() << " ms" << std::endl;
+		ASSERT_EQ(count / chunk_size, commands.commandBuffers.size());
+
+		vcc::command_buffer::command_buffer_type command_buffer(std::move(
+			vcc::command_buffer::allocate(std::ref(device),
+				std::ref(cmd_pool), VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1).front()));
+		vcc::command::compile(vcc::command::build(std::ref(command_buffer),
+			VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, VK_FALSE, 0, 0), commands);
+		vcc::fence::fence_type fence(vcc::fence::create(std::ref(device)));
+		vcc::queue::submit(queue, {}, { command_buffer }, {}, fence);
+		vcc::fence::wait(device, { fence }, true, std::chrono::nanoseconds::max());
+
+		vcc::memory::map_type map(vcc::memory::map(memory));
+		const uint32_t *values(static_cast<const uint32_t *>(map.data));
+		for (std::size_t i = 0; i < count; i += 997) {
+			ASSERT_EQ(i, values[i]);
+		}
+		std::fill(static_cast<uint32_t *>(map.data), static_cast<uint32_t *>(map.data) + count,
+			uint32_t(0));
+	}
+	// Only the pools of the widest recording are left, none is in use.
+	vcc::command_recorder::shrink(recorder);
+}
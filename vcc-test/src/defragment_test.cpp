@@ -0,0 +1,78 @@
+/*
+* Copyright 2016 Google Inc. All Rights Reserved.
+
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+
+* http://www.apache.org/licenses/LICENSE-2.0
+
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <vcc/buffer.h>
+#include <vcc/defragment.h>
+#include <vcc/fence.h>
+#include <vcc/memory.h>
+#include "device_fixture.h"
+
+namespace {
+
+VkDeviceMemory get_device_memory(const vcc::buffer::buffer_type &buffer) {
+	return vcc::internal::get_instance(*vcc::internal::get_memory(buffer));
+}
+
+}  // anonymous namespace
+
+// Fills a block and starts a second with a few buffers, then frees every
+// other buffer of the first. Steps with a budget smaller than any buffer
+// still move one buffer each, until all of the second block are moved into
+// the denser first block.
+TEST(DefragmentTest, StepProgressesUnderSmallBudget) {
+	test::device_fixture_type fixture;
+	vcc::device::device_type &device(fixture.device);
+
+	const VkDeviceSize size(1 << 20);
+	const std::size_t max_buffers(1024), sparse_count(3);
+	std::vector<std::shared_ptr<vcc::buffer::buffer_type>> buffers;
+	std::size_t first_block_count(0);
+	while (buffers.size() < max_buffers && (!first_block_count
+			|| buffers.size() < first_block_count + sparse_count)) {
+		buffers.push_back(std::make_shared<vcc::buffer::buffer_type>(vcc::buffer::create(
+			std::ref(device), 0, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+				| VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_SHARING_MODE_EXCLUSIVE, {})));
+		vcc::memory::bind(std::ref(device), 0, *buffers.back());
+		if (!first_block_count
+				&& get_device_memory(*buffers.back()) != get_device_memory(*buffers.front())) {
+			first_block_count = buffers.size() - 1;
+		}
+	}
+	ASSERT_NE(0u, first_block_count);
+	const VkDeviceMemory first_block(get_device_memory(*buffers.front()));
+	for (std::size_t i = 0; i < first_block_count; i += 2) {
+		buffers[i].reset();
+	}
+
+	vcc::defragment::defragmenter_type defragmenter;
+	for (std::size_t i = first_block_count; i < buffers.size(); ++i) {
+		vcc::defragment::add(defragmenter, buffers[i]);
+	}
+	for (std::size_t i = 0; i < sparse_count; ++i) {
+		EXPECT_EQ(1u, vcc::defragment::step(defragmenter, fixture.queue, 1).size());
+	}
+	EXPECT_TRUE(vcc::defragment::step(defragmenter, fixture.queue, 1).empty());
+	for (std::size_t i = first_block_count; i < buffers.size(); ++i) {
+		EXPECT_EQ(first_block, get_device_memory(*buffers[i]));
+	}
+
+	// Executes the copies before the old buffers are released.
+	vcc::fence::fence_type fence(vcc::fence::create(std::ref(device)));
+	vcc::queue::submit(fixture.queue, {}, {}, {}, fence);
+	vcc::fence::wait(device, { fence }, true, std::chrono::nanoseconds::max());
+}
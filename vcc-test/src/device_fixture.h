@@ -0,0 +1,54 @@
+/*
+* Copyright 2016 Google Inc. All Rights Reserved.
+
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+
+* http://www.apache.org/licenses/LICENSE-2.0
+
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#ifndef DEVICE_FIXTURE_H_
+#define DEVICE_FIXTURE_H_
+
+#include <vcc/device.h>
+#include <vcc/instance.h>
+#include <vcc/physical_device.h>
+#include <vcc/queue.h>
+
+namespace test {
+
+// An instance, a device of its first physical device with one compute
+// queue and that queue, for the tests needing a device.
+struct device_fixture_type {
+	device_fixture_type()
+		: instance(vcc::instance::create({}, {})),
+		physical_device(vcc::physical_device::enumerate(instance).front()),
+		device(vcc::device::create(physical_device,
+			{ vcc::device::queue_create_info_type{
+				vcc::physical_device::get_queue_family_properties_with_flag(
+					vcc::physical_device::queue_famility_properties(
+						physical_device),
+					VK_QUEUE_COMPUTE_BIT),
+					{ 0 } }
+			}, {}, {}, {})),
+		queue(vcc::queue::get_queue(std::ref(device), VK_QUEUE_COMPUTE_BIT)) {}
+
+	// The queue and users of the device refer to the members in place.
+	device_fixture_type(const device_fixture_type &) = delete;
+	device_fixture_type &operator=(const device_fixture_type &) = delete;
+
+	vcc::instance::instance_type instance;
+	const VkPhysicalDevice physical_device;
+	vcc::device::device_type device;
+	vcc::queue::queue_type queue;
+};
+
+}  // namespace test
+
+#endif /* DEVICE_FIXTURE_H_ */
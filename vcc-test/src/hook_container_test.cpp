@@ -0,0 +1,81 @@
+/*
+* Copyright 2016 Google Inc. All Rights Reserved.
+
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+
+* http://www.apache.org/licenses/LICENSE-2.0
+
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include <gtest/gtest.h>
+#include <vcc/internal/hook.h>
+
+namespace {
+
+struct target_type {
+	int value;
+};
+
+}  // anonymous namespace
+
+TEST(HookContainerTest, Unkeyed) {
+	vcc::internal::hook_container_type<int &> hooks;
+	for (int i = 0; i < 3; ++i) {
+		hooks.add([](int &count) { ++count; });
+	}
+	int count(0);
+	hooks(count);
+	EXPECT_EQ(3, count);
+}
+
+TEST(HookContainerTest, DeduplicateTarget) {
+	target_type first{ 1 }, second{ 2 };
+	vcc::internal::hook_container_type<int &> hooks;
+	for (int i = 0; i < 1000; ++i) {
+		hooks.add(first, [&first](int &sum) { sum += first.value; });
+		hooks.add(second, [&second](int &sum) { sum += second.value; });
+	}
+	int sum(0);
+	hooks(sum);
+	EXPECT_EQ(3, sum);
+
+	hooks.clear();
+	hooks.add(first, [&first](int &sum) { sum += first.value; });
+	sum = 0;
+	hooks(sum);
+	EXPECT_EQ(1, sum);
+}
+
+// Targets shared by containers called with the same set run once.
+TEST(HookContainerTest, Called) {
+	target_type first{ 1 }, second{ 2 };
+	vcc::internal::hook_container_type<int &> a, b;
+	a.add(first, [&first](int &sum) { sum += first.value; });
+	b.add(first, [&first](int &sum) { sum += first.value; });
+	b.add(second, [&second](int &sum) { sum += second.value; });
+	b.add([](int &sum) { sum += 10; });
+	vcc::internal::object_key_set_type called;
+	int sum(0);
+	a(called, sum);
+	b(called, sum);
+	EXPECT_EQ(13, sum);
+}
+
+// A member sharing the address of the object holding it is a target of its own.
+TEST(HookContainerTest, TargetType) {
+	struct outer_type {
+		target_type inner;
+	} outer{ { 1 } };
+	vcc::internal::hook_container_type<int &> hooks;
+	hooks.add(outer, [](int &count) { ++count; });
+	hooks.add(outer.inner, [](int &count) { ++count; });
+	int count(0);
+	hooks(count);
+	EXPECT_EQ(2, count);
+}
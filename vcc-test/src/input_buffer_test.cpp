@@ -0,0 +1,79 @@
+/*
+* Copyright 2016 Google Inc. All Rights Reserved.
+
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+
+* http://www.apache.org/licenses/LICENSE-2.0
+
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include <gtest/gtest.h>
+#include <type/types.h>
+#include <vcc/buffer.h>
+#include <vcc/command.h>
+#include <vcc/command_pool.h>
+#include <vcc/fence.h>
+#include <vcc/input_buffer.h>
+#include <vcc/memory.h>
+#include <vcc/queue.h>
+#include "device_fixture.h"
+
+// Overlapping writes flushed several times before a submit are copied in
+// one queued copy, extended by each flush, and all land in the buffer.
+TEST(InputBufferTest, FlushesBetweenSubmits) {
+	test::device_fixture_type fixture;
+	vcc::device::device_type &device(fixture.device);
+	vcc::queue::queue_type &queue(fixture.queue);
+
+	const std::size_t count(1024), flushes(10);
+	type::float_array array(count, 0.f);
+	vcc::input_buffer::input_buffer_type input_buffer(
+		vcc::input_buffer::create<type::linear>(std::ref(device), 0,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_SHARING_MODE_EXCLUSIVE, {},
+			std::ref(array)));
+	vcc::memory::bind(std::ref(device), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, input_buffer);
+	vcc::buffer::buffer_type output(vcc::buffer::create(std::ref(device), 0,
+		count * sizeof(float), VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_SHARING_MODE_EXCLUSIVE, {}));
+	const type::supplier<const vcc::memory::memory_type> output_memory(vcc::memory::bind(
+		std::ref(device), VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+			| VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, output));
+
+	for (std::size_t i = 0; i < flushes; ++i) {
+		{
+			auto write_array(type::write(array));
+			for (std::size_t j = i * 64; j < i * 64 + 128; ++j) {
+				write_array[j] = float(i + 1);
+			}
+		}
+		ASSERT_TRUE(vcc::input_buffer::flush_on_submit(queue, input_buffer));
+	}
+
+	vcc::command_pool::command_pool_type cmd_pool(vcc::command_pool::create(
+		std::ref(device), 0, vcc::queue::get_family_index(queue)));
+	vcc::command_buffer::command_buffer_type command_buffer(std::move(
+		vcc::command_buffer::allocate(std::ref(device), std::ref(cmd_pool),
+			VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1).front()));
+	vcc::command::compile(vcc::command::build(std::ref(command_buffer),
+			VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, VK_FALSE, 0, 0),
+		vcc::command::copy_buffer_type{
+			std::ref(vcc::input_buffer::internal::get_buffer(input_buffer)),
+			type::make_supplier<const vcc::buffer::buffer_type>(output),
+			{ VkBufferCopy{ 0, 0, count * sizeof(float) } } });
+	vcc::fence::fence_type fence(vcc::fence::create(std::ref(device)));
+	vcc::queue::submit(queue, {}, { command_buffer }, {}, fence);
+	vcc::fence::wait(device, { fence }, true, std::chrono::nanoseconds::max());
+
+	vcc::memory::map_type map(vcc::memory::map(output_memory));
+	const float *values(static_cast<const float *>(map.data));
+	auto read_array(type::read(array));
+	for (std::size_t i = 0; i < count; ++i) {
+		ASSERT_EQ(read_array[i], values[i]);
+	}
+}
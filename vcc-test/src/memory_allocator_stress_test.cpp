@@ -0,0 +1,128 @@
+/*
+* Copyright 2016 Google Inc. All Rights Reserved.
+
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+
+* http://www.apache.org/licenses/LICENSE-2.0
+
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#define NOMINMAX
+#include <algorithm>
+#include <chrono>
+#include <gtest/gtest.h>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <set>
+#include <tuple>
+#include <vcc/buffer.h>
+#include <vcc/device.h>
+#include <vcc/memory.h>
+#include <vcc/physical_device.h>
+#include "device_fixture.h"
+
+namespace {
+
+typedef std::tuple<VkDeviceMemory, VkDeviceSize, VkDeviceSize> range_type;
+
+// Asserts that no two bound buffers overlap and returns the number of
+// distinct VkDeviceMemory objects they use.
+std::size_t check_ranges(const std::vector<vcc::buffer::buffer_type> &buffers) {
+	std::vector<range_type> ranges;
+	for (const vcc::buffer::buffer_type &buffer : buffers) {
+		if (!vcc::internal::get_instance(buffer)) {
+			continue;
+		}
+		const vcc::memory::memory_type &memory(*vcc::internal::get_memory(buffer));
+		ranges.emplace_back(vcc::internal::get_instance(memory),
+			vcc::internal::get_offset(memory) + vcc::internal::get_offset(buffer),
+			vcc::memory::internal::get_memory_requirements(buffer).size);
+	}
+	std::sort(ranges.begin(), ranges.end());
+	std::set<VkDeviceMemory> memories;
+	for (std::size_t i = 0; i < ranges.size(); ++i) {
+		memories.insert(std::get<0>(ranges[i]));
+		if (i > 0 && std::get<0>(ranges[i - 1]) == std::get<0>(ranges[i])) {
+			EXPECT_LE(std::get<1>(ranges[i - 1]) + std::get<2>(ranges[i - 1]),
+				std::get<1>(ranges[i]));
+		}
+	}
+	return memories.size();
+}
+
+uint64_t allocation_count(const vcc::device::device_type &device) {
+	uint64_t count(0);
+	for (const vcc::memory::heap_statistics_type &heap : vcc::memory::statistics(device)) {
+		count += heap.allocation_count;
+	}
+	return count;
+}
+
+}  // anonymous namespace
+
+TEST(MemoryAllocatorStressTest, AllocateFree100kBuffers) {
+	test::device_fixture_type fixture;
+	vcc::device::device_type &device(fixture.device);
+	const VkPhysicalDevice physical_device(fixture.physical_device);
+	const uint32_t max_allocations(vcc::physical_device::properties(physical_device)
+		.limits.maxMemoryAllocationCount);
+
+	const std::size_t num_buffers(100000);
+	std::mt19937 random(0);
+	std::uniform_int_distribution<VkDeviceSize> size_distribution(16, 4096);
+	std::vector<vcc::buffer::buffer_type> buffers(num_buffers);
+	std::vector<std::size_t> order(num_buffers);
+	std::iota(order.begin(), order.end(), 0);
+
+	const auto allocate([&](std::size_t index) {
+		buffers[index] = vcc::buffer::create(std::ref(device), 0,
+			size_distribution(random), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_SHARING_MODE_EXCLUSIVE, {});
+		vcc::memory::bind(std::ref(device), 0, buffers[index]);
+	});
+	const auto elapsed([](std::chrono::steady_clock::time_point start) {
+		return std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now() - start).count();
+	});
+
+	auto start(std::chrono::steady_clock::now());
+	for (std::size_t i = 0; i < num_buffers; ++i) {
+		allocate(i);
+	}
+	std::cout << "Allocated " << num_buffers << " buffers in "
+		<< elapsed(start) << " ms" << std::endl;
+	const std::size_t num_memories(check_ranges(buffers));
+	EXPECT_LE(num_memories, max_allocations);
+	EXPECT_LT(num_memories, num_buffers / 100);
+	EXPECT_EQ(num_buffers, allocation_count(device));
+
+	// Free half in random order and refill the holes.
+	std::shuffle(order.begin(), order.end(), random);
+	start = std::chrono::steady_clock::now();
+	for (std::size_t i = 0; i < num_buffers / 2; ++i) {
+		buffers[order[i]] = vcc::buffer::buffer_type();
+	}
+	for (std::size_t i = 0; i < num_buffers / 2; ++i) {
+		allocate(order[i]);
+	}
+	std::cout << "Freed and reallocated " << num_buffers / 2 << " buffers in "
+		<< elapsed(start) << " ms" << std::endl;
+	EXPECT_LE(check_ranges(buffers), max_allocations);
+
+	std::shuffle(order.begin(), order.end(), random);
+	start = std::chrono::steady_clock::now();
+	for (std::size_t index : order) {
+		buffers[index] = vcc::buffer::buffer_type();
+	}
+	std::cout << "Freed " << num_buffers << " buffers in "
+		<< elapsed(start) << " ms" << std::endl;
+	EXPECT_EQ(0u, allocation_count(device));
+	std::cout << vcc::memory::dump_statistics(device) << std::endl;
+}
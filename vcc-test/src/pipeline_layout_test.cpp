@@ -0,0 +1,45 @@
+/*
+* Copyright 2016 Google Inc. All Rights Reserved.
+
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+
+* http://www.apache.org/licenses/LICENSE-2.0
+
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include <cstring>
+#include <gtest/gtest.h>
+#include <type/storage.h>
+#include <vcc/pipeline_layout.h>
+
+namespace {
+
+float get(const std::string &buffer, std::size_t index) {
+	float value;
+	std::memcpy(&value, &buffer[index * sizeof(float)], sizeof(float));
+	return value;
+}
+
+}  // anonymous namespace
+
+TEST(PipelineLayoutTest, UpdateKeepsUnwrittenConstants) {
+	type::t_primitive<float> first(1.f), second(2.f);
+	vcc::pipeline_layout::internal::constants_type constants(
+		type::make_serialize<type::linear>(type::make_supplier(std::ref(first)),
+			type::make_supplier(std::ref(second))));
+	ASSERT_TRUE(vcc::pipeline_layout::internal::update(constants));
+	ASSERT_EQ(1.f, get(constants.buffer, 0));
+	ASSERT_EQ(2.f, get(constants.buffer, 1));
+	ASSERT_FALSE(vcc::pipeline_layout::internal::update(constants));
+
+	type::write(second)[0] = 3.f;
+	ASSERT_TRUE(vcc::pipeline_layout::internal::update(constants));
+	ASSERT_EQ(1.f, get(constants.buffer, 0));
+	ASSERT_EQ(3.f, get(constants.buffer, 1));
+}
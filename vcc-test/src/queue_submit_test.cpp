@@ -0,0 +1,77 @@
+/*
+* Copyright 2016 Google Inc. All Rights Reserved.
+
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+
+* http://www.apache.org/licenses/LICENSE-2.0
+
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include <gtest/gtest.h>
+#include <vcc/buffer.h>
+#include <vcc/command.h>
+#include <vcc/command_pool.h>
+#include <vcc/device.h>
+#include <vcc/fence.h>
+#include <vcc/memory.h>
+#include <vcc/queue.h>
+#include <vcc/semaphore.h>
+#include "device_fixture.h"
+
+// Three batches in one submit, each filling a part of a buffer, the later
+// ones waiting for a semaphore signaled by the batch before.
+TEST(QueueSubmitTest, Batches) {
+	test::device_fixture_type fixture;
+	vcc::device::device_type &device(fixture.device);
+	vcc::queue::queue_type &queue(fixture.queue);
+
+	const std::size_t batch_count(3), count(256);
+	vcc::buffer::buffer_type buffer(vcc::buffer::create(std::ref(device), 0,
+		batch_count * count * sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_SHARING_MODE_EXCLUSIVE, {}));
+	const type::supplier<const vcc::memory::memory_type> memory(vcc::memory::bind(
+		std::ref(device), VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+			| VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer));
+
+	vcc::command_pool::command_pool_type cmd_pool(vcc::command_pool::create(
+		std::ref(device), 0, vcc::queue::get_family_index(queue)));
+	std::vector<vcc::command_buffer::command_buffer_type> command_buffers(
+		vcc::command_buffer::allocate(std::ref(device), std::ref(cmd_pool),
+			VK_COMMAND_BUFFER_LEVEL_PRIMARY, uint32_t(batch_count)));
+	std::vector<vcc::semaphore::semaphore_type> semaphores;
+	for (std::size_t i = 0; i + 1 < batch_count; ++i) {
+		semaphores.push_back(vcc::semaphore::create(std::ref(device)));
+	}
+
+	std::vector<vcc::queue::submit_info_type> submits(batch_count);
+	for (std::size_t i = 0; i < batch_count; ++i) {
+		vcc::command::compile(vcc::command::build(std::ref(command_buffers[i]),
+				VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, VK_FALSE, 0, 0),
+			vcc::command::fill_buffer{
+				type::make_supplier<const vcc::buffer::buffer_type>(buffer),
+				i * count * sizeof(uint32_t), count * sizeof(uint32_t), uint32_t(i + 1) });
+		if (i) {
+			submits[i].wait_semaphores.push_back(vcc::queue::wait_semaphore{
+				std::ref(semaphores[i - 1]), VK_PIPELINE_STAGE_TRANSFER_BIT });
+		}
+		submits[i].command_buffers.push_back(std::cref(command_buffers[i]));
+		if (i + 1 < batch_count) {
+			submits[i].signal_semaphores.push_back(std::cref(semaphores[i]));
+		}
+	}
+	vcc::fence::fence_type fence(vcc::fence::create(std::ref(device)));
+	vcc::queue::submit(queue, submits, fence);
+	vcc::fence::wait(device, { fence }, true, std::chrono::nanoseconds::max());
+
+	vcc::memory::map_type map(vcc::memory::map(memory));
+	const uint32_t *values(static_cast<const uint32_t *>(map.data));
+	for (std::size_t i = 0; i < batch_count * count; ++i) {
+		ASSERT_EQ(i / count + 1, values[i]);
+	}
+}
@@ -0,0 +1,82 @@
+/*
+* Copyright 2016 Google Inc. All Rights Reserved.
+
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+
+* http://www.apache.org/licenses/LICENSE-2.0
+
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include <gtest/gtest.h>
+#include <vcc/fence.h>
+#include <vcc/queue.h>
+#include <vcc/ring_buffer.h>
+#include "device_fixture.h"
+
+namespace {
+
+// Submits nothing but the fence, signaling it once the queue gets to it.
+void signal(const vcc::queue::queue_type &queue, const vcc::fence::fence_type &fence) {
+	vcc::queue::submit(queue, {}, {}, {}, fence);
+}
+
+}  // anonymous namespace
+
+// Slices are handed out from the region of the current frame, going back to
+// the first region after the last one.
+TEST(RingBufferTest, WrapAround) {
+	test::device_fixture_type fixture;
+	const uint32_t frames(3);
+	vcc::ring_buffer::ring_buffer_type ring(vcc::ring_buffer::create(
+		std::ref(fixture.device), 256, frames));
+	uint32_t frame_size(0);
+	for (uint32_t frame = 0; frame < 2 * frames; ++frame) {
+		const vcc::ring_buffer::slice_type first(vcc::ring_buffer::allocate(ring, 64));
+		const vcc::ring_buffer::slice_type second(vcc::ring_buffer::allocate(ring, 64));
+		if (frame == 1) {
+			frame_size = first.offset;
+		}
+		EXPECT_EQ(frame % frames * frame_size, first.offset);
+		EXPECT_LT(first.offset, second.offset);
+		*static_cast<uint32_t *>(first.data) = frame;
+		const std::shared_ptr<vcc::fence::fence_type> fence(
+			std::make_shared<vcc::fence::fence_type>(
+				vcc::fence::create(std::ref(fixture.device))));
+		signal(fixture.queue, *fence);
+		vcc::ring_buffer::next_frame(ring, fence);
+	}
+	EXPECT_LE(256u, frame_size);
+	EXPECT_THROW(vcc::ring_buffer::allocate(ring, frame_size + 1), vcc::vcc_exception);
+}
+
+// Ending a frame waits for the fence of the region coming up, and throws
+// instead of blocking forever if that fence was never submitted.
+TEST(RingBufferTest, FenceWait) {
+	test::device_fixture_type fixture;
+	vcc::ring_buffer::ring_buffer_type ring(vcc::ring_buffer::create(
+		std::ref(fixture.device), 256, 2));
+	const std::shared_ptr<vcc::fence::fence_type> first(
+		std::make_shared<vcc::fence::fence_type>(
+			vcc::fence::create(std::ref(fixture.device))));
+	const std::shared_ptr<vcc::fence::fence_type> second(
+		std::make_shared<vcc::fence::fence_type>(
+			vcc::fence::create(std::ref(fixture.device))));
+	// The second region has not been used, nothing to wait for.
+	vcc::ring_buffer::next_frame(ring, first);
+	const uint32_t offset(vcc::ring_buffer::allocate(ring, 64).offset);
+	EXPECT_THROW(vcc::ring_buffer::next_frame(ring, second, std::chrono::milliseconds(10)),
+		vcc::vcc_exception);
+	// The frame is still current.
+	EXPECT_LT(offset, vcc::ring_buffer::allocate(ring, 64).offset);
+	signal(fixture.queue, *first);
+	vcc::ring_buffer::next_frame(ring, second);
+	EXPECT_EQ(0u, vcc::ring_buffer::allocate(ring, 64).offset);
+	signal(fixture.queue, *second);
+	vcc::fence::wait(fixture.device, { *second }, true);
+}
@@ -25,6 +25,15 @@ namespace memory {
 
 namespace buffer {
 
+// The parameters the buffer was created with.
+struct create_info_type {
+	VkBufferCreateFlags flags;
+	VkDeviceSize size;
+	VkBufferUsageFlags usage;
+	VkSharingMode sharingMode;
+	std::vector<uint32_t> queueFamilyIndices;
+};
+
 struct buffer_type
 	: public internal::movable_destructible_with_parent_and_memory<VkBuffer,
 		const device::device_type, const memory::memory_type, vkDestroyBuffer> {
@@ -33,6 +42,7 @@ struct buffer_type
 		VkBufferCreateFlags flags, VkDeviceSize size,
 		VkBufferUsageFlags usage, VkSharingMode sharingMode,
 		const std::vector<uint32_t> &queueFamilyIndices);
+	friend const create_info_type &get_create_info(const buffer_type &buffer);
 
 	buffer_type() = default;
 	buffer_type(buffer_type &&) = default;
@@ -41,8 +51,12 @@ struct buffer_type
 	buffer_type &operator=(const buffer_type &) = delete;
 
 private:
-	buffer_type(VkBuffer instance, const type::supplier<const device::device_type> &parent)
-		: movable_destructible_with_parent_and_memory(instance, parent) {}
+	buffer_type(VkBuffer instance, const type::supplier<const device::device_type> &parent,
+		create_info_type &&create_info)
+		: movable_destructible_with_parent_and_memory(instance, parent),
+		  create_info(std::move(create_info)) {}
+
+	create_info_type create_info;
 };
 
 VCC_LIBRARY buffer_type create(
@@ -51,6 +65,10 @@ VCC_LIBRARY buffer_type create(
 	VkBufferUsageFlags usage, VkSharingMode sharingMode,
 	const std::vector<uint32_t> &queueFamilyIndices);
 
+inline const create_info_type &get_create_info(const buffer_type &buffer) {
+	return buffer.create_info;
+}
+
 }  // namespace buffer
 }  // namespace vcc
 
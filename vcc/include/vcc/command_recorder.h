@@ -0,0 +1,105 @@
+/*
+* Copyright 2016 Google Inc. All Rights Reserved.
+
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+
+* http://www.apache.org/licenses/LICENSE-2.0
+
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#ifndef COMMAND_RECORDER_H_
+#define COMMAND_RECORDER_H_
+
+#include <functional>
+#include <memory>
+#include <type/executor.h>
+#include <vcc/command.h>
+
+namespace vcc {
+namespace command_recorder {
+namespace internal {
+
+struct pools_type;
+
+}  // namespace internal
+
+// Records secondary command buffers on the threads of an executor.
+// Command pools are externally synchronized, so each recording task takes a
+// pool no other task is using and a pool is created when all are taken,
+// leaving one pool per concurrently recording thread.
+// Pools are kept between recordings and their number never shrinks by
+// itself: it is bounded by the most tasks the executor ran at once. Call
+// shrink after a peak to release the pools not in use.
+struct command_recorder_type {
+	friend VCC_LIBRARY command_recorder_type create(
+		const type::supplier<const device::device_type> &device,
+		uint32_t queueFamilyIndex);
+	friend VCC_LIBRARY command::execute_commands record(command_recorder_type &recorder,
+		const type::executor_type &executor, VkCommandBufferUsageFlags flags,
+		const type::supplier<const render_pass::render_pass_type> &render_pass,
+		uint32_t subpass,
+		const type::supplier<const framebuffer::framebuffer_type> &framebuffer,
+		std::size_t count, std::size_t chunk_size,
+		const std::function<void(command::build_type &, std::size_t, std::size_t)> &function);
+	friend VCC_LIBRARY command::execute_commands record(command_recorder_type &recorder,
+		const type::executor_type &executor, VkCommandBufferUsageFlags flags,
+		std::size_t count, std::size_t chunk_size,
+		const std::function<void(command::build_type &, std::size_t, std::size_t)> &function);
+	friend VCC_LIBRARY void shrink(command_recorder_type &recorder);
+
+	command_recorder_type() = default;
+	command_recorder_type(command_recorder_type &&) = default;
+	command_recorder_type(const command_recorder_type &) = delete;
+	command_recorder_type &operator=(command_recorder_type &&) = default;
+	command_recorder_type &operator=(const command_recorder_type &) = delete;
+
+private:
+	explicit command_recorder_type(const std::shared_ptr<internal::pools_type> &pools)
+		: pools(pools) {}
+
+	// The pools not taken by a task, behind a pointer to keep the recorder movable.
+	std::shared_ptr<internal::pools_type> pools;
+};
+
+VCC_LIBRARY command_recorder_type create(
+	const type::supplier<const device::device_type> &device,
+	uint32_t queueFamilyIndex);
+
+// Records the items [first, last) of a draw list into build.
+// Must not free command buffers allocated by the recorder.
+typedef std::function<void(command::build_type &build, std::size_t first,
+	std::size_t last)> record_function_type;
+
+// Splits the count items of a draw list in chunks of chunk_size items, each
+// recorded into a secondary command buffer by a task on executor. The
+// secondaries continue subpass of render_pass in framebuffer. Returns once
+// all are recorded, rethrowing the first exception of a task, with the
+// secondaries in the order of their chunks, to be compiled into the primary.
+// executor is called from the calling thread only. If it throws, the chunks
+// already handed over are waited for before the exception is rethrown.
+VCC_LIBRARY command::execute_commands record(command_recorder_type &recorder,
+	const type::executor_type &executor, VkCommandBufferUsageFlags flags,
+	const type::supplier<const render_pass::render_pass_type> &render_pass,
+	uint32_t subpass,
+	const type::supplier<const framebuffer::framebuffer_type> &framebuffer,
+	std::size_t count, std::size_t chunk_size, const record_function_type &function);
+
+// As above, for secondaries recorded outside of a render pass.
+VCC_LIBRARY command::execute_commands record(command_recorder_type &recorder,
+	const type::executor_type &executor, VkCommandBufferUsageFlags flags,
+	std::size_t count, std::size_t chunk_size, const record_function_type &function);
+
+// Releases the pools no recording is using. A released pool is destroyed
+// once the secondaries allocated from it are.
+VCC_LIBRARY void shrink(command_recorder_type &recorder);
+
+}  // namespace command_recorder
+}  // namespace vcc
+
+#endif /* COMMAND_RECORDER_H_ */
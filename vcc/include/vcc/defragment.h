@@ -0,0 +1,89 @@
+/*
+ * Copyright 2016 Google Inc. All Rights Reserved.
+
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef DEFRAGMENT_H_
+#define DEFRAGMENT_H_
+
+#include <functional>
+#include <mutex>
+#include <vcc/buffer.h>
+#include <vcc/descriptor_set.h>
+#include <vcc/queue.h>
+#include <vector>
+
+namespace vcc {
+namespace defragment {
+
+/*
+ * Compacts the heaps by moving registered buffers out of sparsely used blocks
+ * into denser ones, so the emptied blocks are released. The buffer_type objects
+ * stay the same, only their VkBuffer and memory change.
+ *
+ * A buffer is moved only if it was added through an owning supplier, was created
+ * with VK_BUFFER_USAGE_TRANSFER_SRC_BIT and VK_BUFFER_USAGE_TRANSFER_DST_BIT and
+ * is the only resource bound to its memory. It must not be written by the device, pending writes would be lost.
+ *
+ * A move swaps the VkBuffer inside the buffer_type. Command buffers recorded
+ * before the move keep referencing the old VkBuffer, destroyed once the copy
+ * has executed, so they must not be submitted again until recorded anew.
+ */
+class defragmenter_type {
+	friend VCC_LIBRARY void add(defragmenter_type &defragmenter,
+		const type::supplier<buffer::buffer_type> &buffer);
+	friend VCC_LIBRARY void add(defragmenter_type &defragmenter,
+		const type::supplier<descriptor_set::descriptor_set_type> &descriptor_set);
+	friend VCC_LIBRARY void remove(defragmenter_type &defragmenter,
+		const buffer::buffer_type &buffer);
+	friend VCC_LIBRARY void remove(defragmenter_type &defragmenter,
+		const descriptor_set::descriptor_set_type &descriptor_set);
+	friend VCC_LIBRARY std::vector<std::reference_wrapper<const buffer::buffer_type>> step(
+		defragmenter_type &defragmenter, const queue::queue_type &queue, VkDeviceSize budget);
+
+public:
+	defragmenter_type() : next(0) {}
+	defragmenter_type(const defragmenter_type &) = delete;
+	defragmenter_type &operator=(const defragmenter_type &) = delete;
+
+private:
+	std::mutex mutex;
+	std::vector<type::supplier<buffer::buffer_type>> buffers;
+	std::vector<type::supplier<descriptor_set::descriptor_set_type>> descriptor_sets;
+	// The buffer the next step starts at, so every buffer gets its turn.
+	std::size_t next;
+};
+
+VCC_LIBRARY void add(defragmenter_type &defragmenter,
+	const type::supplier<buffer::buffer_type> &buffer);
+// Descriptor sets referencing a moved buffer are rewritten by step.
+VCC_LIBRARY void add(defragmenter_type &defragmenter,
+	const type::supplier<descriptor_set::descriptor_set_type> &descriptor_set);
+VCC_LIBRARY void remove(defragmenter_type &defragmenter,
+	const buffer::buffer_type &buffer);
+VCC_LIBRARY void remove(defragmenter_type &defragmenter,
+	const descriptor_set::descriptor_set_type &descriptor_set);
+
+// Moves registered buffers of at most budget bytes in total, but at least one
+// if any can be moved so a buffer larger than budget is not skipped forever.
+// The copies are executed by the next queue::submit on queue, ahead of its
+// command buffers. Command buffers using a moved buffer must be recorded again
+// and the registered descriptor sets are updated, so neither may be in use by
+// pending work. Returns the moved buffers.
+VCC_LIBRARY std::vector<std::reference_wrapper<const buffer::buffer_type>> step(
+	defragmenter_type &defragmenter, const queue::queue_type &queue, VkDeviceSize budget);
+
+}  // namespace defragment
+}  // namespace vcc
+
+#endif /* DEFRAGMENT_H_ */
@@ -17,6 +17,7 @@
 #define DESCRIPTOR_SET_H_
 
 #include <algorithm>
+#include <unordered_map>
 #include <vcc/buffer.h>
 #include <vcc/buffer_view.h>
 #include <vcc/device.h>
@@ -35,6 +36,13 @@ struct queue_type;
 
 namespace descriptor_set {
 
+// A buffer written to a descriptor, so it can be rewritten if the buffer moves.
+struct buffer_descriptor_type {
+	const buffer::buffer_type *buffer;
+	VkDescriptorType descriptor_type;
+	VkDeviceSize offset, range;
+};
+
 struct descriptor_set_type : public internal::movable_allocated_with_pool_parent2<VkDescriptorSet,
 		const device::device_type, const descriptor_pool::descriptor_pool_type, vkFreeDescriptorSets> {
 
@@ -53,6 +61,8 @@ struct descriptor_set_type : public internal::movable_allocated_with_pool_parent
 		util::hash_pair<uint32_t, uint32_t>, const queue::queue_type &> pre_execute_callbacks;
 	internal::reference_map_type<std::pair<uint32_t, uint32_t>,
 		util::hash_pair<uint32_t, uint32_t>> references;
+	std::unordered_map<std::pair<uint32_t, uint32_t>, buffer_descriptor_type,
+		util::hash_pair<uint32_t, uint32_t>> buffer_descriptors;
 };
 
 VCC_LIBRARY std::vector<descriptor_set_type> create(
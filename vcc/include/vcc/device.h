@@ -20,6 +20,14 @@
 #include <vcc/util.h>
 
 namespace vcc {
+namespace memory {
+namespace internal {
+
+struct allocator_type;
+
+}  // namespace internal
+}  // namespace memory
+
 namespace device {
 
 struct queue_create_info_type {
@@ -35,6 +43,7 @@ struct device_type
 		const std::set<std::string> &extensions,
 		const VkPhysicalDeviceFeatures &features);
 	friend VkPhysicalDevice get_physical_device(const device_type &device);
+	friend memory::internal::allocator_type &get_allocator(const device_type &device);
 
 	device_type() = default;
 	device_type(const device_type&) = delete;
@@ -43,10 +52,14 @@ struct device_type
 	device_type &operator=(device_type&&copy) = default;
 
 private:
-	device_type(VkDevice device, VkPhysicalDevice physical_device)
-		: movable_destructible(device), physical_device(physical_device) {}
+	device_type(VkDevice device, VkPhysicalDevice physical_device,
+		const std::shared_ptr<memory::internal::allocator_type> &allocator)
+		: movable_destructible(device), physical_device(physical_device),
+		  allocator(allocator) {}
 
 	internal::handle_type<VkPhysicalDevice> physical_device;
+	// Heap manager used by memory::bind, released before the device is destroyed.
+	std::shared_ptr<memory::internal::allocator_type> allocator;
 };
 
 VCC_LIBRARY device_type create(VkPhysicalDevice physical_device,
@@ -61,6 +74,10 @@ inline VkPhysicalDevice get_physical_device(const device_type &device) {
 	return device.physical_device;
 }
 
+inline memory::internal::allocator_type &get_allocator(const device_type &device) {
+	return *device.allocator;
+}
+
 }  // namespace device
 }  // namespace vcc
 
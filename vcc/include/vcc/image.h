@@ -47,9 +47,12 @@ struct image_type
 		swapchain::swapchain_type &swapchain);
 	friend VkImageType get_type(const image_type &image);
 	friend VkImageType get_type(const image_type &image);
+	friend VkImageCreateFlags get_flags(const image_type &image);
 	friend VkFormat get_format(const image_type &image);
+	friend const VkExtent3D &get_extent(const image_type &image);
 	friend uint32_t get_mip_levels(const image_type &image);
 	friend uint32_t get_array_layers(const image_type &image);
+	friend VkImageTiling get_tiling(const image_type &image);
 
 	image_type() = default;
 	image_type(const image_type&) = delete;
@@ -59,14 +62,19 @@ struct image_type
 
 private:
 	image_type(VkImage instance, const type::supplier<const device::device_type> &parent,
-		bool destructible, VkImageType type, VkFormat format, uint32_t mipLevels,
-		uint32_t arrayLayers)
+		bool destructible, VkImageCreateFlags flags, VkImageType type, VkFormat format,
+		const VkExtent3D &extent, uint32_t mipLevels, uint32_t arrayLayers,
+		VkImageTiling tiling)
 		:  movable_conditional_destructible_with_parent_and_memory(instance, parent, destructible)
-		, type(type), format(format), mipLevels(mipLevels), arrayLayers(arrayLayers) {}
+		, flags(flags), type(type), format(format), extent(extent), mipLevels(mipLevels)
+		, arrayLayers(arrayLayers), tiling(tiling) {}
 
+	VkImageCreateFlags flags;
 	VkImageType type;
 	VkFormat format;
+	VkExtent3D extent;
 	uint32_t mipLevels, arrayLayers;
+	VkImageTiling tiling;
 };
 
 VCC_LIBRARY image_type create(
@@ -81,10 +89,18 @@ inline VkImageType get_type(const image_type &image) {
 	return image.type;
 }
 
+inline VkImageCreateFlags get_flags(const image_type &image) {
+	return image.flags;
+}
+
 inline VkFormat get_format(const image_type &image) {
 	return image.format;
 }
 
+inline const VkExtent3D &get_extent(const image_type &image) {
+	return image.extent;
+}
+
 inline uint32_t get_mip_levels(const image_type &image) {
 	return image.mipLevels;
 }
@@ -93,9 +109,18 @@ inline uint32_t get_array_layers(const image_type &image) {
 	return image.arrayLayers;
 }
 
+inline VkImageTiling get_tiling(const image_type &image) {
+	return image.tiling;
+}
+
 VCC_LIBRARY VkSubresourceLayout get_subresource_layout(image_type &image,
 	const VkImageSubresource &subresource);
 
+// Images created with VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT are bound tile by
+// tile through queue::bind_sparse, see page_table.h, instead of memory::bind.
+VCC_LIBRARY std::vector<VkSparseImageMemoryRequirements> get_sparse_memory_requirements(
+	const image_type &image);
+
 /*
  * Copy to the mipmap level 0, array 0 of an VK_IMAGE_TILING_LINEAR image.
  */
@@ -30,6 +30,8 @@ struct queue_type;
 namespace input_buffer {
 namespace internal {
 
+struct staging_type;
+
 template<typename T>
 auto get_mutex(const T &value)->decltype(value.mutex)& {
 	return value.mutex;
@@ -73,6 +75,8 @@ class input_buffer_type {
 		StorageType... );
 	friend VCC_LIBRARY bool flush(const input_buffer_type &buffer);
 	friend VCC_LIBRARY bool flush(const queue::queue_type &queue, const input_buffer_type &buffer);
+	friend VCC_LIBRARY bool flush_on_submit(const queue::queue_type &queue,
+		const input_buffer_type &buffer);
 	template<typename U>
 	friend auto internal::get_mutex(const U &value)->decltype(value.mutex)&;
 	template<typename U>
@@ -90,6 +94,7 @@ public:
 		std::unique_lock<std::mutex> lock(copy.mutex);
 		serialize = std::move(copy.serialize);
 		buffer = std::move(copy.buffer);
+		staging = std::move(copy.staging);
 	}
 	input_buffer_type &operator=(const input_buffer_type&) = delete;
 	input_buffer_type &operator=(input_buffer_type &&copy) {
@@ -98,6 +103,7 @@ public:
 		std::unique_lock<std::mutex> copy_lock(copy.mutex, std::adopt_lock);
 		serialize = std::move(copy.serialize);
 		buffer = std::move(copy.buffer);
+		staging = std::move(copy.staging);
 		return *this;
 	}
 
@@ -109,17 +115,23 @@ private:
 		Serialize serialize)
 		: serialize(std::forward<Serialize>(serialize)),
 		  buffer(std::forward<buffer::buffer_type>(
-			  buffer::create(device, flags, type::size(serialize), usage,
+			  buffer::create(device, flags, type::size(serialize),
+				  usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 				  sharingMode, queueFamilyIndices))) {}
 
 	type::serialize_type serialize;
 	buffer::buffer_type buffer;
+	// Staging ring used when bound to memory that is not host visible,
+	// created on the first flush.
+	mutable std::shared_ptr<internal::staging_type> staging;
 	mutable std::mutex mutex;
 };
 
 /*
  * Creates a buffer_type containing the given data.
  * Notice: The buffer must be bound to memory before usage.
+ * If bound to memory that is not host visible, such as device local memory,
+ * the content is uploaded through staging buffers and must be flushed on a queue.
  */
 template<type::memory_layout Layout, typename... StorageType>
 input_buffer_type create(const type::supplier<const device::device_type> &device,
@@ -131,12 +143,20 @@ input_buffer_type create(const type::supplier<const device::device_type> &device
 }
 
 // Flushes content of the buffer to the GPU if there is data with an old revision.
+// Throws if the buffer is not bound to host visible memory.
 VCC_LIBRARY bool flush(const input_buffer_type &buffer);
 
 // Flushes content of the buffer to the GPU if there is data with an old revision.
-// A memory barrier is pushed on the queue.
+// Buffers in memory that is not host visible get the changed ranges copied from
+// a staging buffer on queue, blocking until the copy has executed.
 VCC_LIBRARY bool flush(const queue::queue_type &queue, const input_buffer_type &buffer);
 
+// As flush on a queue, without blocking: the changed ranges are copied from a
+// ring of staging buffers first thing in the next queue::submit on queue.
+// Used by the pre-execute hooks of commands reading the buffer.
+VCC_LIBRARY bool flush_on_submit(const queue::queue_type &queue,
+	const input_buffer_type &buffer);
+
 }  // namespace input_buffer
 }  // namespace vcc
 
@@ -0,0 +1,193 @@
+/*
+ * Copyright 2016 Google Inc. All Rights Reserved.
+
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef ALLOCATOR_H_
+#define ALLOCATOR_H_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <vcc/util.h>
+#include <vector>
+
+namespace vcc {
+namespace memory {
+namespace internal {
+
+// Binary buddy allocator over the range [0, size).
+// size and min_size must be powers of two. Not thread safe.
+struct buddy_type {
+	buddy_type() : min_size(0), used(0) {}
+	VCC_LIBRARY buddy_type(VkDeviceSize size, VkDeviceSize min_size);
+
+	// Returns false if there is no free node large enough.
+	// node_size is set to the size of the node handed out.
+	VCC_LIBRARY bool allocate(VkDeviceSize size, VkDeviceSize alignment,
+		VkDeviceSize *offset, VkDeviceSize *node_size);
+	// Returns the size of the node freed.
+	VCC_LIBRARY VkDeviceSize free(VkDeviceSize offset);
+
+	bool empty() const {
+		return allocated.empty();
+	}
+
+	// Size of the largest free node, zero if there is none.
+	VCC_LIBRARY VkDeviceSize largest_free() const;
+
+	// Total size of the allocated nodes.
+	VkDeviceSize allocated_size() const {
+		return used;
+	}
+
+private:
+	VkDeviceSize node_size(std::size_t order) const {
+		return min_size << order;
+	}
+
+	VkDeviceSize min_size, used;
+	// Free node offsets, indexed by order.
+	std::vector<std::set<VkDeviceSize>> free_lists;
+	// Order of each allocated node, keyed by offset.
+	std::unordered_map<VkDeviceSize, std::size_t> allocated;
+};
+
+struct pool_type;
+
+// Counters of one memory heap, updated without locks.
+struct heap_counters_type {
+	heap_counters_type() : block_bytes(0), block_count(0), allocated_bytes(0),
+		peak_allocated_bytes(0), allocation_count(0) {}
+
+	// Sums node sizes for sub-allocations and block sizes for dedicated ones.
+	VCC_LIBRARY void allocated(VkDeviceSize size);
+	void freed(VkDeviceSize size) {
+		allocated_bytes -= size;
+		--allocation_count;
+	}
+
+	std::atomic<VkDeviceSize> block_bytes;
+	std::atomic<uint32_t> block_count;
+	std::atomic<VkDeviceSize> allocated_bytes, peak_allocated_bytes;
+	std::atomic<uint64_t> allocation_count;
+};
+
+// One VkDeviceMemory. Either sub-allocated through a pool or
+// dedicated to a single memory_type if pool is null.
+// Host visible blocks are mapped once for their whole lifetime.
+struct block_type {
+	block_type(VkDevice device, VkDeviceMemory memory, VkDeviceSize size,
+		VkDeviceSize non_coherent_atom_size, pool_type *pool,
+		heap_counters_type *counters, void *data)
+		: device(device), memory(memory), size(size),
+		  non_coherent_atom_size(non_coherent_atom_size), pool(pool),
+		  counters(counters), data(data) {}
+	block_type(const block_type &) = delete;
+	block_type &operator=(const block_type &) = delete;
+	VCC_LIBRARY ~block_type();
+
+	const VkDevice device;
+	const VkDeviceMemory memory;
+	const VkDeviceSize size, non_coherent_atom_size;
+	pool_type *const pool;
+	heap_counters_type *const counters;
+	// Guarded by pool->mutex.
+	buddy_type buddy;
+	// Persistent mapping of the whole block, null unless host visible.
+	void *const data;
+};
+
+// Blocks of one memory type index holding either linear
+// (buffers) or non-linear (optimal images) resources, never both,
+// so neighbours never violate bufferImageGranularity.
+struct pool_type {
+	pool_type(uint32_t memoryTypeIndex, VkDeviceSize block_size)
+		: memoryTypeIndex(memoryTypeIndex), block_size(block_size) {}
+	pool_type(const pool_type &) = delete;
+	pool_type &operator=(const pool_type &) = delete;
+
+	const uint32_t memoryTypeIndex;
+	const VkDeviceSize block_size;
+	std::mutex mutex;
+	std::vector<std::shared_ptr<block_type>> blocks;
+};
+
+struct allocation_type {
+	std::shared_ptr<block_type> block;
+	VkDeviceSize offset;
+};
+
+// Per device memory heap manager, owned by device::device_type.
+struct allocator_type {
+	// dedicated_allocation is true if VK_KHR_get_memory_requirements2 and
+	// VK_KHR_dedicated_allocation are enabled on device.
+	VCC_LIBRARY allocator_type(VkDevice device,
+		const VkPhysicalDeviceMemoryProperties &memory_properties,
+		const VkPhysicalDeviceLimits &limits, bool dedicated_allocation);
+	allocator_type(const allocator_type &) = delete;
+	allocator_type &operator=(const allocator_type &) = delete;
+
+	// Allocations larger than half a block, or with such alignment,
+	// get a dedicated VkDeviceMemory. Returns a null block if the heap is
+	// out of device memory, so another memory type can be tried.
+	VCC_LIBRARY allocation_type allocate(VkDeviceSize size,
+		VkDeviceSize alignment, uint32_t memoryTypeIndex, bool linear);
+
+	// A VkDeviceMemory of its own for the buffer or image, whichever is not
+	// VK_NULL_HANDLE, passed on through VkMemoryDedicatedAllocateInfoKHR.
+	// Returns a null block if the heap is out of device memory.
+	VCC_LIBRARY allocation_type allocate_dedicated(VkDeviceSize size,
+		uint32_t memoryTypeIndex, VkBuffer buffer, VkImage image);
+
+	// Sub-allocates from another block of the pool of block, holding more data
+	// than block does, never allocating a new block. Used to compact pools.
+	// Returns a null block if there is none with room.
+	VCC_LIBRARY allocation_type allocate_denser(VkDeviceSize size,
+		VkDeviceSize alignment, const block_type &block);
+
+	// Largest free node of the blocks of each heap, locks the pools.
+	VCC_LIBRARY std::vector<VkDeviceSize> largest_free() const;
+
+	const VkDevice device;
+	const VkPhysicalDeviceMemoryProperties memory_properties;
+	const VkDeviceSize buffer_image_granularity, non_coherent_atom_size;
+	// Indexed by heap.
+	std::unique_ptr<heap_counters_type[]> counters;
+#ifdef VK_KHR_dedicated_allocation
+	// Null unless dedicated allocations are enabled.
+	PFN_vkGetBufferMemoryRequirements2KHR get_buffer_memory_requirements2;
+	PFN_vkGetImageMemoryRequirements2KHR get_image_memory_requirements2;
+#endif  // VK_KHR_dedicated_allocation
+
+private:
+	// Returns null on VK_ERROR_OUT_OF_DEVICE_MEMORY.
+	std::shared_ptr<block_type> allocate_block(uint32_t memoryTypeIndex,
+		VkDeviceSize size, pool_type *pool, const void *next = NULL);
+
+	// Two pools per memory type, linear at even and non-linear at odd index.
+	std::vector<std::unique_ptr<pool_type>> pools;
+};
+
+// Returns the range to its block. Empty blocks are released,
+// except the last one of each pool.
+VCC_LIBRARY void free(const std::shared_ptr<block_type> &block,
+	VkDeviceSize offset);
+
+}  // namespace internal
+}  // namespace memory
+}  // namespace vcc
+
+#endif // ALLOCATOR_H_
@@ -16,16 +16,230 @@
 #ifndef _VCC_INTERNAL_HOOK_H_
 #define _VCC_INTERNAL_HOOK_H_
 
+#include <algorithm>
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <new>
+#include <type/supplier.h>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
 
 namespace vcc {
 namespace internal {
 
+// Storage for objects derived from BaseT that are destroyed together.
+// Objects are placed in blocks that are kept by clear(), so filling a
+// cleared arena with as many objects again allocates nothing.
+template<typename BaseT>
+class arena_type {
+public:
+	typedef typename std::vector<BaseT *>::const_iterator const_iterator;
+
+	arena_type() : block(0), offset(0) {}
+	arena_type(const arena_type &) = delete;
+	arena_type(arena_type &&copy)
+		: blocks(std::move(copy.blocks)), objects(std::move(copy.objects)),
+		  block(copy.block), offset(copy.offset) {
+		copy.blocks.clear();
+		copy.objects.clear();
+		copy.block = copy.offset = 0;
+	}
+	arena_type &operator=(const arena_type &) = delete;
+	arena_type &operator=(arena_type &&copy) {
+		clear();
+		blocks = std::move(copy.blocks);
+		objects = std::move(copy.objects);
+		block = copy.block;
+		offset = copy.offset;
+		copy.blocks.clear();
+		copy.objects.clear();
+		copy.block = copy.offset = 0;
+		return *this;
+	}
+	~arena_type() {
+		clear();
+	}
+
+	template<typename U, typename... ArgsT>
+	U *create(ArgsT&&... args) {
+		static_assert(std::is_base_of<BaseT, U>::value, "U must derive from BaseT");
+		void *memory(allocate(sizeof(U), alignof(U)));
+		objects.push_back(nullptr);
+		try {
+			U *object(new (memory) U(std::forward<ArgsT>(args)...));
+			objects.back() = object;
+			return object;
+		} catch (...) {
+			objects.pop_back();
+			throw;
+		}
+	}
+
+	// Destroys the objects in reverse order of creation.
+	void clear() {
+		for (auto it(objects.rbegin()); it != objects.rend(); ++it) {
+			(*it)->~BaseT();
+		}
+		objects.clear();
+		block = offset = 0;
+	}
+
+	const_iterator begin() const {
+		return objects.begin();
+	}
+
+	const_iterator end() const {
+		return objects.end();
+	}
+
+	std::size_t size() const {
+		return objects.size();
+	}
+
+private:
+	static const std::size_t block_size = 4096;
+
+	struct block_type {
+		std::unique_ptr<char[]> data;
+		std::size_t size;
+	};
+
+	void *allocate(std::size_t size, std::size_t alignment) {
+		for (;;) {
+			if (block < blocks.size()) {
+				const std::size_t begin((offset + alignment - 1) / alignment * alignment);
+				if (begin + size <= blocks[block].size) {
+					offset = begin + size;
+					return blocks[block].data.get() + begin;
+				}
+				++block;
+				offset = 0;
+			} else {
+				// new char[] is aligned for any fundamental type.
+				const std::size_t new_size(std::max(size, std::size_t(block_size)));
+				blocks.push_back(block_type{ std::unique_ptr<char[]>(new char[new_size]),
+					new_size });
+			}
+		}
+	}
+
+	std::vector<block_type> blocks;
+	std::vector<BaseT *> objects;
+	// The block being filled and the first free byte within it.
+	std::size_t block, offset;
+};
+
+// Identifies an object along with its type, as a member may share the
+// address of the object holding it.
+struct object_key_type {
+	const void *object, *type;
+};
+
+template<typename T>
+const void *type_key() {
+	static const char key(0);
+	return &key;
+}
+
+template<typename T>
+object_key_type object_key(const T &object) {
+	return object_key_type{ &object, type_key<T>() };
+}
+
+// Open addressing set of object keys, at most half full.
+// clear() keeps the memory.
+class object_key_set_type {
+public:
+	object_key_set_type() : count(0) {}
+	object_key_set_type(const object_key_set_type &) = delete;
+	object_key_set_type(object_key_set_type &&copy)
+		: keys(std::move(copy.keys)), count(copy.count) {
+		copy.keys.clear();
+		copy.count = 0;
+	}
+	object_key_set_type &operator=(const object_key_set_type &) = delete;
+	object_key_set_type &operator=(object_key_set_type &&copy) {
+		keys = std::move(copy.keys);
+		count = copy.count;
+		copy.keys.clear();
+		copy.count = 0;
+		return *this;
+	}
+
+	// Returns false if key is already present.
+	bool insert(const object_key_type &key) {
+		if ((count + 1) * 2 > keys.size()) {
+			std::vector<object_key_type> old_keys(std::max(keys.size() * 2, std::size_t(16)),
+				object_key_type{ nullptr, nullptr });
+			old_keys.swap(keys);
+			for (const object_key_type &old_key : old_keys) {
+				if (old_key.object) {
+					keys[find(old_key)] = old_key;
+				}
+			}
+		}
+		const std::size_t index(find(key));
+		if (keys[index].object) {
+			return false;
+		}
+		keys[index] = key;
+		++count;
+		return true;
+	}
+
+	void clear() {
+		std::fill(keys.begin(), keys.end(), object_key_type{ nullptr, nullptr });
+		count = 0;
+	}
+
+private:
+	static std::size_t hash(const object_key_type &key) {
+		const std::size_t hash(std::size_t(reinterpret_cast<std::uintptr_t>(key.object) >> 4)
+			^ std::size_t(reinterpret_cast<std::uintptr_t>(key.type) >> 4) * 31);
+		return hash ^ (hash >> 11);
+	}
+
+	// The slot holding key or the empty slot it belongs in.
+	std::size_t find(const object_key_type &key) const {
+		const std::size_t mask(keys.size() - 1);
+		std::size_t index(hash(key) & mask);
+		while (keys[index].object
+				&& (keys[index].object != key.object || keys[index].type != key.type)) {
+			index = (index + 1) & mask;
+		}
+		return index;
+	}
+
+	std::vector<object_key_type> keys;
+	std::size_t count;
+};
+
+// Callbacks are stored in an arena rather than as std::function, so adding
+// a callback to a container cleared with clear() allocates nothing.
+// A callback added for a target is added once per target, and runs once per
+// set of called keys when the container is called with one.
 template<typename... T>
 class hook_container_type {
+private:
+	struct callback_instance {
+		explicit callback_instance(const object_key_type &key) : key(key) {}
+		virtual ~callback_instance() {}
+		virtual void operator()(T... value) const = 0;
+		// Has a null object if the callback has no target.
+		object_key_type key;
+	};
+	template<typename FunctionT>
+	struct template_callback_instance : public callback_instance {
+		template<typename U>
+		template_callback_instance(const object_key_type &key, U &&function)
+			: callback_instance(key), function(std::forward<U>(function)) {}
+		void operator()(T... value) const {
+			function(value...);
+		}
+		FunctionT function;
+	};
 public:
 	typedef std::function<void(T...)> callback_type;
 	hook_container_type() = default;
@@ -34,20 +248,45 @@ public:
 	hook_container_type &operator=(const hook_container_type&) = delete;
 	hook_container_type &operator=(hook_container_type&&) = default;
 
-	void add(const callback_type &callback) {
-		callbacks.push_back(callback);
+	template<typename FunctionT>
+	void add(FunctionT &&callback) {
+		callbacks.template create<template_callback_instance<
+			typename std::decay<FunctionT>::type>>(object_key_type{ nullptr, nullptr },
+				std::forward<FunctionT>(callback));
 	}
-	void add(callback_type &&callback) {
-		callbacks.push_back(std::forward<callback_type>(callback));
+
+	// Adds callback unless a callback for target has been added already.
+	template<typename TargetT, typename FunctionT>
+	void add(const TargetT &target, FunctionT &&callback) {
+		const object_key_type key(object_key(target));
+		if (keys.insert(key)) {
+			callbacks.template create<template_callback_instance<
+				typename std::decay<FunctionT>::type>>(key, std::forward<FunctionT>(callback));
+		}
+	}
+
+	void clear() {
+		callbacks.clear();
+		keys.clear();
 	}
 
 	void operator() (T... value) const {
-		for (const callback_type &callback : callbacks) {
-			callback(value...);
+		for (const callback_instance *callback : callbacks) {
+			(*callback)(value...);
+		}
+	}
+
+	// Skips the callbacks whose target is in called, adding the others'.
+	void operator() (object_key_set_type &called, T... value) const {
+		for (const callback_instance *callback : callbacks) {
+			if (!callback->key.object || called.insert(callback->key)) {
+				(*callback)(value...);
+			}
 		}
 	}
 private:
-	std::vector<callback_type> callbacks;
+	arena_type<callback_instance> callbacks;
+	object_key_set_type keys;
 };
 
 template<typename KeyT, typename Hash, typename... T>
@@ -75,16 +314,18 @@ private:
 	callbacks_container_type callbacks;
 };
 
+// Keeps the values of suppliers alive. Each object is kept once no matter
+// how many times it is added, references from std::ref are not kept at all
+// as they do not own their value. Instances live in an arena, see clear().
 class reference_container_type {
 private:
 	struct instance {
 		virtual ~instance() {}
 	};
-	template<typename... T>
+	template<typename T>
 	struct template_instance : public instance {
-		template_instance(T... value) : value(std::forward<T>(value)...) {}
-		template_instance(const std::tuple<T...> &value) : value(value) {}
-		std::tuple<T...> value;
+		explicit template_instance(const T &value) : value(value) {}
+		T value;
 	};
 public:
 	reference_container_type() = default;
@@ -93,12 +334,27 @@ public:
 	reference_container_type &operator=(const reference_container_type &) = delete;
 	reference_container_type &operator=(reference_container_type &&) = default;
 
-	template<typename... T>
-	void add(T... value) {
-		instances.emplace_back(new template_instance<T...>(std::forward<T>(value)...));
+	template<typename T>
+	void add(const type::supplier<T> &value) {
+		if (value.owner() && keys.insert(object_key(*value))) {
+			instances.create<template_instance<type::supplier<T>>>(value);
+		}
+	}
+
+	template<typename T, typename U, typename... V>
+	void add(const T &first, const U &second, const V &... rest) {
+		add(first);
+		add(second, rest...);
+	}
+
+	// Releases the values, keeping the memory for the next recording.
+	void clear() {
+		instances.clear();
+		keys.clear();
 	}
 private:
-	std::vector<std::shared_ptr<instance>> instances;
+	arena_type<instance> instances;
+	object_key_set_type keys;
 };
 
 template<typename KeyT, typename HashT = std::hash<KeyT>>
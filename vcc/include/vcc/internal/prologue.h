@@ -0,0 +1,113 @@
+/*
+ * Copyright 2016 Google Inc. All Rights Reserved.
+
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef PROLOGUE_H_
+#define PROLOGUE_H_
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vcc/buffer.h>
+#include <vcc/command_buffer.h>
+#include <vcc/command_pool.h>
+#include <vcc/fence.h>
+#include <vector>
+
+namespace vcc {
+namespace queue {
+namespace internal {
+
+typedef uint64_t serial_type;
+
+// Transfers requested by pre-execute hooks. queue::submit records them into
+// one command buffer that executes ahead of the submitted command buffers,
+// so flushing any number of input buffers costs no extra fence wait.
+// Each recorded prologue gets a serial, increasing by one per prologue.
+struct prologue_type {
+	prologue_type(const type::supplier<const device::device_type> &device,
+		uint32_t family_index)
+		: device(device), family_index(family_index), next_serial(1),
+		  submitted_serial(0) {}
+	prologue_type(const prologue_type &) = delete;
+	prologue_type &operator=(const prologue_type &) = delete;
+	VCC_LIBRARY ~prologue_type();
+
+	// Queues a copy for the next prologue. src and dst are kept alive until the
+	// copy has executed. Returns the serial of the prologue the copy is
+	// recorded in.
+	VCC_LIBRARY serial_type copy(
+		const type::supplier<const buffer::buffer_type> &src,
+		const type::supplier<const buffer::buffer_type> &dst,
+		std::vector<VkBufferCopy> &&regions);
+
+	// Adds regions to the copy from src queued for serial if it has not been
+	// recorded yet. write is called first, with the lock held so the copy is
+	// not recorded meanwhile. Returns false, without calling write, otherwise.
+	VCC_LIBRARY bool amend(serial_type serial, const buffer::buffer_type &src,
+		const std::vector<VkBufferCopy> &regions, const std::function<void()> &write);
+
+	// True if the prologue has been passed to vkQueueSubmit.
+	VCC_LIBRARY bool submitted(serial_type serial);
+
+	// Blocks until a submitted prologue has finished executing. The lock is
+	// not held while waiting, so copies may be queued meanwhile.
+	VCC_LIBRARY void wait(serial_type serial);
+
+	// Records the queued copies, returns VK_NULL_HANDLE if there are none.
+	// Otherwise the submission executing the command buffer must signal
+	// fence and submitted() must be called once it has been submitted, or
+	// failed() if the submit failed. Must be called with the queue locked.
+	VCC_LIBRARY VkCommandBuffer record(VkFence *fence);
+	VCC_LIBRARY void submitted();
+	// Queues the copies of the recorded prologue again for the next one.
+	VCC_LIBRARY void failed();
+
+private:
+	struct copy_type {
+		type::supplier<const buffer::buffer_type> src, dst;
+		std::vector<VkBufferCopy> regions;
+	};
+
+	struct frame_type {
+		command_pool::command_pool_type command_pool;
+		command_buffer::command_buffer_type command_buffer;
+		fence::fence_type fence;
+		// 0 for a frame never submitted, free to be recorded again.
+		serial_type serial;
+		// The copies recorded, queued again if the submit fails.
+		std::vector<copy_type> copies;
+		// Threads in wait on the fence, which must not be reset meanwhile.
+		std::size_t waiters;
+	};
+
+	// Returns a frame whose previous commands have finished executing.
+	frame_type &acquire_frame();
+
+	const type::supplier<const device::device_type> device;
+	const uint32_t family_index;
+	std::mutex mutex;
+	std::vector<copy_type> copies;
+	// In submission order, the oldest first. The last frame is the one
+	// being recorded between record() and submitted().
+	std::deque<std::unique_ptr<frame_type>> frames;
+	serial_type next_serial, submitted_serial;
+};
+
+}  // namespace internal
+}  // namespace queue
+}  // namespace vcc
+
+#endif // PROLOGUE_H_
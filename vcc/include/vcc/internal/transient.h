@@ -0,0 +1,78 @@
+/*
+ * Copyright 2016 Google Inc. All Rights Reserved.
+
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef TRANSIENT_H_
+#define TRANSIENT_H_
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vcc/command_buffer.h>
+#include <vcc/command_pool.h>
+#include <vcc/fence.h>
+#include <vector>
+
+namespace vcc {
+namespace queue {
+
+struct queue_type;
+
+namespace internal {
+
+// Command buffers for one-shot work done by the library itself, such as
+// push constant updates and image uploads. Each frame owns a transient pool
+// with a single primary command buffer. Frames are recycled with
+// vkResetCommandPool once the fence of their last submission has signaled,
+// instead of creating and destroying a pool per operation.
+// A frame is used by one thread at a time, concurrent callers get frames of
+// their own so no pool is recorded into from two threads.
+struct transient_type {
+	struct frame_type {
+		type::supplier<const command_pool::command_pool_type> command_pool;
+		command_buffer::command_buffer_type command_buffer;
+		fence::fence_type fence;
+		// Set once submitted with fence, until then the frame is free as is.
+		bool submitted;
+	};
+
+	transient_type(const type::supplier<const device::device_type> &device,
+		uint32_t family_index) : device(device), family_index(family_index) {}
+	transient_type(const transient_type &) = delete;
+	transient_type &operator=(const transient_type &) = delete;
+	VCC_LIBRARY ~transient_type();
+
+	// Returns a frame whose command buffer may be recorded, its pool reset.
+	VCC_LIBRARY std::unique_ptr<frame_type> acquire();
+
+	// Returns frame to the cache, it may still be executing if submitted.
+	VCC_LIBRARY void release(std::unique_ptr<frame_type> &&frame);
+
+private:
+	const type::supplier<const device::device_type> device;
+	const uint32_t family_index;
+	std::mutex mutex;
+	std::vector<std::unique_ptr<frame_type>> frames;
+};
+
+// Records into a command buffer from the transient frames of queue, submits
+// it and blocks until it has finished executing.
+VCC_LIBRARY void execute(const queue_type &queue,
+	const std::function<void(command_buffer::command_buffer_type &)> &record);
+
+}  // namespace internal
+}  // namespace queue
+}  // namespace vcc
+
+#endif // TRANSIENT_H_
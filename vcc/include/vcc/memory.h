@@ -18,6 +18,7 @@
 
 #include <climits>
 #include <numeric>
+#include <string>
 #include <vcc/buffer.h>
 #include <vcc/input_buffer.h>
 #include <vcc/device.h>
@@ -27,27 +28,86 @@
 namespace vcc {
 namespace memory {
 
-struct memory_type : vcc::internal::movable_destructible_with_parent<
-		VkDeviceMemory, const device::device_type, vkFreeMemory> {
+struct memory_type;
+struct map_type;
+
+namespace internal {
+
+struct block_type;
+
+// What memory::bind needs to know about each resource.
+struct requirements_type {
+	VkMemoryRequirements requirements;
+	// Linear and non-linear resources must not share a bufferImageGranularity page.
+	bool linear;
+	// Never written by the device, so the host only writes it and does not
+	// read it back, as for staging buffers and vertex data.
+	bool write_only;
+	// Reported through VK_KHR_dedicated_allocation, false if it is not enabled.
+	bool prefers_dedicated, requires_dedicated;
+	// The resource, one of them VK_NULL_HANDLE, for a dedicated allocation.
+	VkBuffer buffer;
+	VkImage image;
+};
+
+// Allocates a range of the same size and memory type as memory, in a block
+// holding more data than the block of memory. Used to compact the heaps.
+// Returns an empty supplier if memory is shared with resources other than the
+// one with requirements, is a dedicated allocation or there is no such block with room.
+VCC_LIBRARY type::supplier<const memory_type> allocate_denser(
+	const memory_type &memory, const VkMemoryRequirements &requirements);
+
+}  // namespace internal
+
+// A range of device memory, usually sharing its VkDeviceMemory with other
+// memory_types. Allocated through the heap manager of the device and returned
+// to it when the last reference is dropped. Host visible memory stays mapped
+// for its whole lifetime, see map().
+struct memory_type : public vcc::internal::movable_with_parent<
+		VkDeviceMemory, const device::device_type> {
 
 	template<typename... ArgsT>
 	friend type::supplier<const memory_type> bind(
 		const type::supplier<const device::device_type> &device,
 		VkMemoryPropertyFlags propertyFlags, ArgsT&... args);
+	template<typename U>
+	friend const VkDeviceSize &vcc::internal::get_offset(const U &value);
 	friend struct map_type;
+	friend VCC_LIBRARY map_type map(const type::supplier<const memory_type> &memory,
+		VkDeviceSize offset, VkDeviceSize size);
+	friend VCC_LIBRARY void flush(const memory_type &memory, VkDeviceSize offset,
+		VkDeviceSize size);
+	friend VCC_LIBRARY void flush(map_type &map,
+		const std::vector<type::byte_range_type> &ranges);
+	friend VCC_LIBRARY void invalidate(const memory_type &memory, VkDeviceSize offset,
+		VkDeviceSize size);
+	friend VkMemoryPropertyFlags get_property_flags(const memory_type &memory);
+	friend VCC_LIBRARY type::supplier<const memory_type> allocate(
+		const type::supplier<const device::device_type> &device,
+		VkMemoryPropertyFlags propertyFlags, const VkMemoryRequirements &requirements);
+	friend VCC_LIBRARY type::supplier<const memory_type> internal::allocate_denser(
+		const memory_type &memory, const VkMemoryRequirements &requirements);
 
 	memory_type() = default;
 	memory_type(memory_type &&) = default;
+	VCC_LIBRARY ~memory_type();
 
 private:
+	// Picks a memory type and allocates a range large enough for all requirements,
+	// writing the offset of each requirement within the range to offsets.
+	// A single resource preferring a dedicated allocation gets one.
 	VCC_LIBRARY static memory_type allocate(
-		const type::supplier<const device::device_type> &device, VkDeviceSize allocationSize,
-		uint32_t memoryTypeIndex, VkMemoryType type);
+		const type::supplier<const device::device_type> &device,
+		VkMemoryPropertyFlags propertyFlags, const internal::requirements_type *requirements,
+		std::size_t count, VkDeviceSize *offsets);
 
-	memory_type(VkDeviceMemory instance, const type::supplier<const device::device_type> &parent,
-		VkDeviceSize size, VkMemoryType type)
-		: movable_destructible_with_parent(instance, parent), size(size), type(type) {}
+	memory_type(const std::shared_ptr<internal::block_type> &block,
+		const type::supplier<const device::device_type> &parent,
+		VkDeviceSize offset, VkDeviceSize size, VkMemoryType type);
 
+	std::shared_ptr<internal::block_type> block;
+	// Offset of this range within the VkDeviceMemory.
+	VkDeviceSize offset;
 	VkDeviceSize size;
 	VkMemoryType type;
 };
@@ -56,6 +116,10 @@ namespace internal {
 
 VCC_LIBRARY VkMemoryRequirements get_memory_requirements(const image::image_type &image);
 VCC_LIBRARY VkMemoryRequirements get_memory_requirements(const buffer::buffer_type &buffer);
+// Queried through vkGet*MemoryRequirements2KHR if dedicated allocations are enabled.
+VCC_LIBRARY requirements_type get_requirements(const image::image_type &image);
+VCC_LIBRARY requirements_type get_requirements(const buffer::buffer_type &buffer);
+VCC_LIBRARY requirements_type get_requirements(const input_buffer::input_buffer_type &buffer);
 VCC_LIBRARY void bind(const type::supplier<const memory_type> &memory,
 	VkDeviceSize offset, image::image_type &image);
 VCC_LIBRARY void bind(const type::supplier<const memory_type> &memory,
@@ -90,67 +154,91 @@ type::supplier<const memory_type> bind(
 		VkMemoryPropertyFlags propertyFlags,
 		ArgsT&... args) {
 	constexpr size_t num_args(sizeof...(ArgsT));
-	const VkMemoryRequirements memory_requirements[] = { internal::get_memory_requirements(args)... };
+	const internal::requirements_type requirements[] = { internal::get_requirements(args)... };
 	VkDeviceSize offsets[num_args];
-	offsets[0] = 0;
-	uint32_t memoryTypeBits(memory_requirements[0].memoryTypeBits);
-	for (int i = 1; i < num_args; ++i) {
-		auto alignment(memory_requirements[i].alignment);
-		offsets[i] = offsets[i - 1] + memory_requirements[i - 1].size;
-		offsets[i] += (alignment - (offsets[i] % alignment)) % alignment;
-		memoryTypeBits &= memory_requirements[i].memoryTypeBits;
-	}
-	const VkDeviceSize size = offsets[num_args - 1] + memory_requirements[num_args - 1].size;
-	if (!memoryTypeBits) {
-		throw vcc_exception("No memoryTypeBits for all given storage.");
-	}
-	uint32_t memoryTypeIndex;
-	const VkPhysicalDeviceMemoryProperties memory_properties(
-		vcc::physical_device::memory_properties(device::get_physical_device(*device)));
-	for (memoryTypeIndex = 0; memoryTypeIndex < memory_properties.memoryTypeCount; ++memoryTypeIndex) {
-		if ((memoryTypeBits & 1) == 1
-			&& (memory_properties.memoryTypes[memoryTypeIndex].propertyFlags & propertyFlags) == propertyFlags) {
-			break;
-		}
-		memoryTypeBits >>= 1;
-	}
-	if (memoryTypeIndex == memory_properties.memoryTypeCount) {
-		throw vcc_exception("Failed to find valid memoryTypeBits that fits the propertyFlags");
-	}
-	std::shared_ptr<memory_type> memory(std::make_shared<memory_type>(memory_type::allocate(device,
-		size, memoryTypeIndex, memory_properties.memoryTypes[memoryTypeIndex])));
+	std::shared_ptr<memory_type> memory(std::make_shared<memory_type>(memory_type::allocate(
+		device, propertyFlags, requirements, num_args, offsets)));
 	internal::bind_t<num_args>::bind(memory, offsets, std::tie(args...));
 	return memory;
 }
 
+// Allocates memory not bound to any resource, such as the pages bound to
+// sparse resources through queue::bind_sparse.
+VCC_LIBRARY type::supplier<const memory_type> allocate(
+	const type::supplier<const device::device_type> &device,
+	VkMemoryPropertyFlags propertyFlags, const VkMemoryRequirements &requirements);
+
 struct map_type {
 	map_type() = delete;
 	map_type(const map_type&) = delete;
 	map_type(map_type &&copy)
-		: memory(copy.memory), offset(copy.offset), size(copy.size), data(copy.data) {
+		: memory(copy.memory), offset(copy.offset), size(copy.size), data(copy.data),
+		flush_on_destroy(copy.flush_on_destroy) {
 		copy.memory = type::supplier<const memory_type>();
 		copy.data = nullptr;
 		copy.offset = copy.size = 0;
 	}
 	VCC_LIBRARY ~map_type();
 	map_type(const type::supplier<const memory_type> &memory, VkDeviceSize offset,
-		VkDeviceSize size, void *data) : memory(memory) , offset(offset), size(size), data(data) {}
+		VkDeviceSize size, void *data) : memory(memory) , offset(offset), size(size), data(data),
+		flush_on_destroy(true) {}
 	type::supplier<const memory_type> memory;
 
 	VkDeviceSize offset, size;
 	void *data;
+	// Cleared by release.
+	bool flush_on_destroy;
 };
 
-// Returns a map_type which will automatically unmap the memory, RAII style.
+// Returns a view into the persistently mapped memory, host visible memory
+// is mapped once when allocated. Non-coherent memory is flushed when the
+// map_type is destroyed, RAII style.
 // map_type::data is the pointer to the area where the memory is mapped.
+// Offsets are relative to the start of the memory_type.
 VCC_LIBRARY map_type map(const type::supplier<const memory_type> &memory, VkDeviceSize offset = 0,
 	VkDeviceSize size = VK_WHOLE_SIZE);
 
 VCC_LIBRARY void flush(const memory_type &memory, VkDeviceSize offset = 0,
 	VkDeviceSize size = VK_WHOLE_SIZE);
+// Flushes only the given ranges, relative to map.offset, with a single call
+// if the memory is non-coherent. The map_type is left as is, release it to
+// not flush the whole range again when it is destroyed.
+VCC_LIBRARY void flush(map_type &map, const std::vector<type::byte_range_type> &ranges);
+// The map_type no longer flushes when destroyed, the caller flushes what it
+// writes. The memory stays mapped and map.data valid as long as the memory lives.
+inline void release(map_type &map) {
+	map.flush_on_destroy = false;
+}
 VCC_LIBRARY void invalidate(const memory_type &memory, VkDeviceSize offset = 0,
 	VkDeviceSize size = VK_WHOLE_SIZE);
 
+inline VkMemoryPropertyFlags get_property_flags(const memory_type &memory) {
+	return memory.type.propertyFlags;
+}
+
+// Memory allocated through bind on one heap of the device.
+struct heap_statistics_type {
+	VkDeviceSize heap_size;
+	VkMemoryHeapFlags flags;
+	// VkDeviceMemory objects allocated on the heap and their total size.
+	uint32_t block_count;
+	VkDeviceSize block_bytes;
+	// Live memory_types and the bytes they occupy, including alignment.
+	uint64_t allocation_count;
+	VkDeviceSize allocated_bytes, peak_allocated_bytes;
+	// Largest range that can be sub-allocated without a new VkDeviceMemory.
+	VkDeviceSize largest_free_block;
+	// 1 - largest_free_block / free bytes, 0 when the free space is contiguous.
+	float fragmentation;
+};
+
+// Counters are read without locking, only largest_free_block briefly locks
+// each pool. Indexed by heap.
+VCC_LIBRARY std::vector<heap_statistics_type> statistics(const device::device_type &device);
+
+// The statistics of all heaps as a JSON array.
+VCC_LIBRARY std::string dump_statistics(const device::device_type &device);
+
 }  // namespace memory
 }  // namespace vcc
 
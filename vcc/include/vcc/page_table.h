@@ -0,0 +1,110 @@
+/*
+ * Copyright 2016 Google Inc. All Rights Reserved.
+
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef PAGE_TABLE_H_
+#define PAGE_TABLE_H_
+
+#include <unordered_map>
+#include <vcc/image.h>
+#include <vcc/memory.h>
+#include <vcc/queue.h>
+#include <vector>
+
+namespace vcc {
+namespace page_table {
+
+// A tile of a sparse image, x, y and z counted in imageGranularity units of its mip level.
+struct tile_type {
+	uint32_t mip_level, array_layer;
+	uint32_t x, y, z;
+};
+
+/*
+ * Keeps the requested tiles of an image created with
+ * VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT resident within a fixed memory budget,
+ * such as a virtual texture larger than the device memory. Each update commits
+ * the tiles of a feedback list, typically the tiles sampled in an earlier frame,
+ * evicting the least recently requested ones when the budget is used up.
+ * Pages are sub-allocated from chunks of memory allocated as residency grows.
+ *
+ * The mip tail, the mip levels smaller than a tile, is always resident.
+ * The image must not be used after the page table is destroyed.
+ */
+class page_table_type {
+	friend VCC_LIBRARY page_table_type create(
+		const type::supplier<const image::image_type> &image,
+		const queue::queue_type &queue, VkDeviceSize budget, uint32_t keep_updates,
+		VkMemoryPropertyFlags propertyFlags);
+	friend VCC_LIBRARY std::vector<tile_type> update(page_table_type &table,
+		const queue::queue_type &queue, const std::vector<tile_type> &feedback,
+		const std::vector<std::reference_wrapper<const semaphore::semaphore_type>> &wait_semaphores,
+		const std::vector<std::reference_wrapper<const semaphore::semaphore_type>> &signal_semaphores);
+	friend VCC_LIBRARY bool is_resident(const page_table_type &table, const tile_type &tile);
+	friend std::size_t get_resident_count(const page_table_type &table);
+
+public:
+	page_table_type() = default;
+	page_table_type(const page_table_type &) = delete;
+	page_table_type(page_table_type &&) = default;
+	page_table_type &operator=(const page_table_type &) = delete;
+	page_table_type &operator=(page_table_type &&) = default;
+
+private:
+	struct entry_type {
+		uint32_t page;
+		// The update the tile was last requested in.
+		uint64_t requested;
+	};
+
+	type::supplier<const image::image_type> image;
+	VkMemoryPropertyFlags property_flags;
+	// alignment is the size of a page.
+	VkMemoryRequirements requirements;
+	VkSparseImageMemoryRequirements sparse_requirements;
+	uint32_t max_pages, keep_updates;
+	std::vector<type::supplier<const memory::memory_type>> mip_tails, chunks;
+	std::vector<uint32_t> free_pages;
+	std::unordered_map<uint64_t, entry_type> resident;
+	uint64_t updates;
+};
+
+// Binds the mip tails on queue, which must support VK_QUEUE_SPARSE_BINDING_BIT,
+// and leaves the rest of budget for tiles. Tiles requested in the last
+// keep_updates updates are never evicted, so those still read by frames in
+// flight stay bound.
+VCC_LIBRARY page_table_type create(
+	const type::supplier<const image::image_type> &image,
+	const queue::queue_type &queue, VkDeviceSize budget, uint32_t keep_updates = 2,
+	VkMemoryPropertyFlags propertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+// Commits the tiles of feedback that are not resident, ignoring duplicates and
+// tiles outside of the image or in the mip tail, as far as the budget allows.
+// Evictions are unbound in the same bind_sparse. Returns the committed tiles,
+// their content is undefined until uploaded after signal_semaphores.
+VCC_LIBRARY std::vector<tile_type> update(page_table_type &table,
+	const queue::queue_type &queue, const std::vector<tile_type> &feedback,
+	const std::vector<std::reference_wrapper<const semaphore::semaphore_type>> &wait_semaphores,
+	const std::vector<std::reference_wrapper<const semaphore::semaphore_type>> &signal_semaphores);
+
+VCC_LIBRARY bool is_resident(const page_table_type &table, const tile_type &tile);
+
+inline std::size_t get_resident_count(const page_table_type &table) {
+	return table.resident.size();
+}
+
+}  // namespace page_table
+}  // namespace vcc
+
+#endif /* PAGE_TABLE_H_ */
@@ -16,6 +16,8 @@
 #ifndef PIPELINE_LAYOUT_H_
 #define PIPELINE_LAYOUT_H_
 
+#include <memory>
+#include <string>
 #include <type/serialize.h>
 #include <vcc/device.h>
 #include <vcc/descriptor_set_layout.h>
@@ -91,7 +93,21 @@ VCC_LIBRARY pipeline_layout_type create(const type::supplier<const device::devic
 
 namespace internal {
 
-VCC_LIBRARY void flush(const type::supplier<const type::serialize_type> &constants,
+// The push constants of a layout. A flush only serializes the elements
+// written since the previous one, so buffer keeps the content across flushes.
+struct constants_type {
+	explicit constants_type(type::serialize_type &&serialize)
+		: serialize(std::move(serialize)), buffer(type::size(this->serialize), '\0') {}
+
+	type::serialize_type serialize;
+	std::string buffer;
+};
+
+// Serializes what was written since the previous update into buffer.
+// Returns false if nothing was.
+VCC_LIBRARY bool update(constants_type &constants);
+
+VCC_LIBRARY void flush(const std::shared_ptr<constants_type> &constants,
 	VkPipelineLayout pipeline_layout,
 	const std::vector<VkPushConstantRange> &push_constant_ranges,
 	const queue::queue_type &queue);
@@ -115,8 +131,9 @@ pipeline_layout_type create(const type::supplier<const device::device_type> &dev
 	pipeline_layout_type pipeline_layout(create(type::supplier<const device::device_type>(device),
 		set_layouts, push_constant_ranges));
 	pipeline_layout::internal::get_pre_execute_callbacks(pipeline_layout).add(
-		std::bind(&internal::flush, type::make_supplier(type::make_serialize<Layout>(
-			type::make_supplier(std::forward<StorageType>(storages)...))),
+		std::bind(&internal::flush, std::make_shared<internal::constants_type>(
+			type::make_serialize<Layout>(
+				type::make_supplier(std::forward<StorageType>(storages)...))),
 			vcc::internal::get_instance(pipeline_layout), push_constant_ranges,
 			std::placeholders::_1));
 	return std::move(pipeline_layout);
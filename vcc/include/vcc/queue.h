@@ -17,21 +17,49 @@
 #define QUEUE_H_
 
 #include <climits>
+#include <vcc/buffer.h>
 #include <vcc/command_buffer.h>
 #include <vcc/device.h>
 #include <vcc/fence.h>
+#include <vcc/image.h>
 #include <vcc/semaphore.h>
 #include <vcc/surface.h>
 #include <vcc/swapchain.h>
 
 namespace vcc {
+namespace memory {
+
+struct memory_type;
+
+}  // namespace memory
+
 namespace queue {
+namespace internal {
+
+struct prologue_type;
+struct transient_type;
+
+template<typename T>
+auto get_prologue(const T &value)->const decltype(value.prologue)& {
+	return value.prologue;
+}
+
+template<typename T>
+auto get_transient(const T &value)->const decltype(value.transient)& {
+	return value.transient;
+}
+
+}  // namespace internal
 
-struct queue_type : public internal::movable_with_parent<VkQueue, const device::device_type> {
+struct queue_type : public vcc::internal::movable_with_parent<VkQueue, const device::device_type> {
 	friend VCC_LIBRARY queue_type get_device_queue(
 		const type::supplier<const device::device_type> &device,
 		uint32_t queue_family_index, uint32_t queue_index);
 	friend uint32_t get_family_index(const queue_type &queue);
+	template<typename T>
+	friend auto internal::get_prologue(const T &value)->const decltype(value.prologue)&;
+	template<typename T>
+	friend auto internal::get_transient(const T &value)->const decltype(value.transient)&;
 
 	queue_type() = default;
 	queue_type(queue_type &&queue) = default;
@@ -40,10 +68,16 @@ struct queue_type : public internal::movable_with_parent<VkQueue, const device::
 
 private:
 	queue_type(VkQueue instance,
-		const type::supplier<const device::device_type> &parent, uint32_t family_index)
+		const type::supplier<const device::device_type> &parent, uint32_t family_index,
+		const std::shared_ptr<internal::prologue_type> &prologue,
+		const std::shared_ptr<internal::transient_type> &transient)
 		: movable_with_parent(instance, parent),
-		  family_index(family_index) {}
+		  family_index(family_index), prologue(prologue), transient(transient) {}
 	uint32_t family_index;
+	// Transfers queued by pre-execute hooks, executed first by the next submit.
+	std::shared_ptr<internal::prologue_type> prologue;
+	// Recycled command pools for one-shot work of the library on this queue.
+	std::shared_ptr<internal::transient_type> transient;
 };
 
 VCC_LIBRARY queue_type get_device_queue(
@@ -71,7 +105,10 @@ struct wait_semaphore {
 	VkPipelineStageFlags wait_dst_stage_mask;
 };
 
-// TODO(gardell): Support multiple submits
+// Transfers queued by the pre-execute hooks of the command buffers, such as
+// uploads of device local input buffers, are recorded into a prologue command buffer
+// executed ahead of command_buffers. It is part of the same vkQueueSubmit,
+// unless a fence is given in which case it is submitted right before.
 VCC_LIBRARY void submit(const queue_type &queue,
 	const std::vector<wait_semaphore> &wait_semaphores,
 	const std::vector<std::reference_wrapper<const command_buffer::command_buffer_type>> &command_buffers,
@@ -83,6 +120,74 @@ VCC_LIBRARY void submit(const queue_type &queue,
 	const std::vector<std::reference_wrapper<const command_buffer::command_buffer_type>> &command_buffers,
 	const std::vector<std::reference_wrapper<const semaphore::semaphore_type>> &signal_semaphores);
 
+// One batch of a batched submit. A batch starts executing once its wait
+// semaphores are signaled and signals its semaphores when done.
+struct submit_info_type {
+	std::vector<wait_semaphore> wait_semaphores;
+	std::vector<std::reference_wrapper<const command_buffer::command_buffer_type>> command_buffers;
+	std::vector<std::reference_wrapper<const semaphore::semaphore_type>> signal_semaphores;
+};
+
+// Submits all batches with a single vkQueueSubmit, locking the queue once.
+// The prologue executes first within the first batch, or ahead of it if a
+// fence is given. A semaphore may be signaled by one batch and waited for by
+// a later one.
+VCC_LIBRARY void submit(const queue_type &queue, const std::vector<submit_info_type> &submits,
+	const fence::fence_type &fence);
+
+VCC_LIBRARY void submit(const queue_type &queue, const std::vector<submit_info_type> &submits);
+
+// Binds size bytes at resource_offset to memory_offset within memory,
+// or unbinds them if memory is empty.
+struct sparse_memory_bind_type {
+	VkDeviceSize resource_offset, size;
+	type::supplier<const memory::memory_type> memory;
+	VkDeviceSize memory_offset;
+	VkSparseMemoryBindFlags flags;
+};
+
+// Binds a region of an image created with VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT,
+// offset and extent aligned to the imageGranularity of its sparse requirements.
+struct sparse_image_memory_bind_type {
+	VkImageSubresource subresource;
+	VkOffset3D offset;
+	VkExtent3D extent;
+	type::supplier<const memory::memory_type> memory;
+	VkDeviceSize memory_offset;
+	VkSparseMemoryBindFlags flags;
+};
+
+struct sparse_buffer_bind_type {
+	std::reference_wrapper<const buffer::buffer_type> buffer;
+	std::vector<sparse_memory_bind_type> binds;
+};
+
+// Opaque binds cover the mip tails and the metadata of sparse images.
+struct sparse_image_opaque_bind_type {
+	std::reference_wrapper<const image::image_type> image;
+	std::vector<sparse_memory_bind_type> binds;
+};
+
+struct sparse_image_bind_type {
+	std::reference_wrapper<const image::image_type> image;
+	std::vector<sparse_image_memory_bind_type> binds;
+};
+
+struct bind_sparse_info_type {
+	std::vector<std::reference_wrapper<const semaphore::semaphore_type>> wait_semaphores;
+	std::vector<sparse_buffer_bind_type> buffer_binds;
+	std::vector<sparse_image_opaque_bind_type> image_opaque_binds;
+	std::vector<sparse_image_bind_type> image_binds;
+	std::vector<std::reference_wrapper<const semaphore::semaphore_type>> signal_semaphores;
+};
+
+// Updates the memory bindings of sparse resources on a queue supporting
+// VK_QUEUE_SPARSE_BINDING_BIT. Binds are not ordered against submits on the
+// same queue, use the semaphores. The caller keeps the memory alive while bound.
+VCC_LIBRARY void bind_sparse(const queue_type &queue, const bind_sparse_info_type &info,
+	const fence::fence_type &fence);
+VCC_LIBRARY void bind_sparse(const queue_type &queue, const bind_sparse_info_type &info);
+
 VCC_LIBRARY void wait_idle(const queue_type &queue);
 
 VCC_LIBRARY VkResult present(const queue_type &queue,
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2016 Google Inc. All Rights Reserved.
+
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef RING_BUFFER_H_
+#define RING_BUFFER_H_
+
+#include <atomic>
+#include <chrono>
+#include <vcc/buffer.h>
+#include <vcc/fence.h>
+
+namespace vcc {
+namespace ring_buffer {
+
+// A slice of a ring_buffer_type, valid until the frame it was allocated in
+// has finished executing.
+struct slice_type {
+	// Offset within the buffer, pass to command::bind_descriptor_sets::dynamic_offsets.
+	uint32_t offset;
+	// The persistently mapped memory of the slice.
+	void *data;
+};
+
+/*
+ * A persistently mapped buffer split into one region per frame in flight, for data
+ * rewritten every frame such as per draw uniforms. Slices are handed out linearly
+ * from the region of the current frame, so a single descriptor of type
+ * VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC covers all of them.
+ *
+ * allocate may be called from several threads, but not concurrently with next_frame.
+ */
+class ring_buffer_type {
+	friend VCC_LIBRARY ring_buffer_type create(
+		const type::supplier<const device::device_type> &device,
+		VkDeviceSize frame_size, uint32_t frames, VkBufferUsageFlags usage);
+	friend slice_type allocate(ring_buffer_type &ring, VkDeviceSize size);
+	friend VCC_LIBRARY void next_frame(ring_buffer_type &ring,
+		const type::supplier<const fence::fence_type> &fence,
+		std::chrono::nanoseconds timeout);
+	friend const buffer::buffer_type &get_buffer(const ring_buffer_type &ring);
+
+public:
+	ring_buffer_type() : frame_size(0), alignment(1), frame(0), head(0), data(nullptr) {}
+	ring_buffer_type(const ring_buffer_type &) = delete;
+	ring_buffer_type(ring_buffer_type &&copy)
+		: buffer(std::move(copy.buffer)), frame_size(copy.frame_size),
+		  alignment(copy.alignment), fences(std::move(copy.fences)),
+		  frame(copy.frame), head(copy.head.load()), data(copy.data) {
+		copy.data = nullptr;
+	}
+	ring_buffer_type &operator=(const ring_buffer_type &) = delete;
+	ring_buffer_type &operator=(ring_buffer_type &&copy) {
+		buffer = std::move(copy.buffer);
+		frame_size = copy.frame_size;
+		alignment = copy.alignment;
+		fences = std::move(copy.fences);
+		frame = copy.frame;
+		head = copy.head.load();
+		data = copy.data;
+		copy.data = nullptr;
+		return *this;
+	}
+
+private:
+	buffer::buffer_type buffer;
+	VkDeviceSize frame_size, alignment;
+	// The fence of the last submit using each region, if not yet waited for.
+	std::vector<type::supplier<const fence::fence_type>> fences;
+	uint32_t frame;
+	// Bytes allocated in the region of the current frame.
+	std::atomic<VkDeviceSize> head;
+	void *data;
+};
+
+// Creates a host visible ring with frames regions of frame_size bytes each.
+// frame_size is rounded up to the offset alignment of the device.
+VCC_LIBRARY ring_buffer_type create(
+	const type::supplier<const device::device_type> &device,
+	VkDeviceSize frame_size, uint32_t frames,
+	VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+
+// Allocates size bytes aligned for use as a dynamic offset.
+// Throws if the region of the current frame is full.
+inline slice_type allocate(ring_buffer_type &ring, VkDeviceSize size) {
+	const VkDeviceSize offset(ring.head.fetch_add(
+		(size + ring.alignment - 1) / ring.alignment * ring.alignment));
+	if (offset + size > ring.frame_size) {
+		throw vcc_exception("ring_buffer frame is full");
+	}
+	const VkDeviceSize absolute(ring.frame * ring.frame_size + offset);
+	return slice_type{ uint32_t(absolute), static_cast<uint8_t *>(ring.data) + absolute };
+}
+
+// Ends the current frame, fence is the fence of the submit reading its slices.
+// Flushes the slices if the memory is not host coherent and moves on to the
+// next region, waiting for the fence it was ended with if it is still in flight.
+// A fence reset or never submitted would never signal, so the wait is bounded
+// by timeout: if it expires vcc_exception is thrown and the current frame is
+// left as is, to be ended again once the fence is submitted.
+VCC_LIBRARY void next_frame(ring_buffer_type &ring,
+	const type::supplier<const fence::fence_type> &fence,
+	std::chrono::nanoseconds timeout = std::chrono::seconds(1));
+
+// The buffer to write to the descriptor, using the largest slice as range.
+inline const buffer::buffer_type &get_buffer(const ring_buffer_type &ring) {
+	return ring.buffer;
+}
+
+}  // namespace ring_buffer
+}  // namespace vcc
+
+#endif /* RING_BUFFER_H_ */
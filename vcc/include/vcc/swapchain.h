@@ -48,6 +48,7 @@ struct swapchain_type : internal::movable_destructible_with_parent<VkSwapchainKH
 	friend VCC_LIBRARY swapchain_type create(const type::supplier<const device::device_type> &,
 		const create_info_type &);
 	friend VkFormat get_format(swapchain_type &swapchain);
+	friend const VkExtent2D &get_extent(swapchain_type &swapchain);
 
 	swapchain_type() = default;
 	swapchain_type(const swapchain_type &) = delete;
@@ -57,10 +58,13 @@ struct swapchain_type : internal::movable_destructible_with_parent<VkSwapchainKH
 
 private:
 	swapchain_type(VkSwapchainKHR instance,
-		const type::supplier<const device::device_type> &parent, VkFormat format)
-		: movable_destructible_with_parent(instance, parent), format(format) {}
+		const type::supplier<const device::device_type> &parent, VkFormat format,
+		const VkExtent2D &extent)
+		: movable_destructible_with_parent(instance, parent), format(format),
+		  extent(extent) {}
 
 	VkFormat format;
+	VkExtent2D extent;
 };
 
 VCC_LIBRARY swapchain_type create(const type::supplier<const device::device_type> &device,
@@ -82,6 +86,10 @@ inline VkFormat get_format(swapchain_type &swapchain) {
 	return swapchain.format;
 }
 
+inline const VkExtent2D &get_extent(swapchain_type &swapchain) {
+	return swapchain.extent;
+}
+
 }  // namespace swapchain
 }  // namespace vcc
 
@@ -0,0 +1,280 @@
+/*
+* Copyright 2016 Google Inc. All Rights Reserved.
+
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+
+* http://www.apache.org/licenses/LICENSE-2.0
+
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include <algorithm>
+#include <cassert>
+#include <vcc/internal/allocator.h>
+
+namespace vcc {
+namespace memory {
+namespace internal {
+
+namespace {
+
+// Smallest node handed out, large enough for any minUniformBufferOffsetAlignment.
+const VkDeviceSize min_node_size = 256;
+const VkDeviceSize max_block_size = VkDeviceSize(256) << 20;
+
+VkDeviceSize floor_power_of_two(VkDeviceSize value) {
+	VkDeviceSize power(1);
+	while (power <= value / 2) {
+		power <<= 1;
+	}
+	return power;
+}
+
+}  // anonymous namespace
+
+buddy_type::buddy_type(VkDeviceSize size, VkDeviceSize min_size)
+	: min_size(min_size), used(0) {
+	assert(size >= min_size && !(size & (size - 1)) && !(min_size & (min_size - 1)));
+	std::size_t orders(1);
+	while (node_size(orders - 1) < size) {
+		++orders;
+	}
+	free_lists.resize(orders);
+	free_lists.back().insert(0);
+}
+
+bool buddy_type::allocate(VkDeviceSize size, VkDeviceSize alignment,
+		VkDeviceSize *offset, VkDeviceSize *allocated_size) {
+	// Nodes are aligned to their own size, so a node large enough for
+	// both size and alignment satisfies the alignment.
+	const VkDeviceSize required(std::max(size, alignment));
+	std::size_t order(0);
+	while (order < free_lists.size() && node_size(order) < required) {
+		++order;
+	}
+	std::size_t available(order);
+	while (available < free_lists.size() && free_lists[available].empty()) {
+		++available;
+	}
+	if (available >= free_lists.size()) {
+		return false;
+	}
+	const VkDeviceSize node(*free_lists[available].begin());
+	free_lists[available].erase(free_lists[available].begin());
+	// Split down, keeping the lower half and freeing the upper buddy.
+	while (available > order) {
+		--available;
+		free_lists[available].insert(node + node_size(available));
+	}
+	allocated.emplace(node, order);
+	*offset = node;
+	*allocated_size = node_size(order);
+	used += node_size(order);
+	return true;
+}
+
+VkDeviceSize buddy_type::free(VkDeviceSize offset) {
+	const auto it(allocated.find(offset));
+	assert(it != allocated.end());
+	std::size_t order(it->second);
+	const VkDeviceSize size(node_size(order));
+	used -= size;
+	allocated.erase(it);
+	// Merge with the buddy for as long as it is free.
+	while (order + 1 < free_lists.size()) {
+		const VkDeviceSize buddy(offset ^ node_size(order));
+		const auto buddy_it(free_lists[order].find(buddy));
+		if (buddy_it == free_lists[order].end()) {
+			break;
+		}
+		free_lists[order].erase(buddy_it);
+		offset = std::min(offset, buddy);
+		++order;
+	}
+	free_lists[order].insert(offset);
+	return size;
+}
+
+VkDeviceSize buddy_type::largest_free() const {
+	for (std::size_t order = free_lists.size(); order > 0; --order) {
+		if (!free_lists[order - 1].empty()) {
+			return node_size(order - 1);
+		}
+	}
+	return 0;
+}
+
+void heap_counters_type::allocated(VkDeviceSize size) {
+	const VkDeviceSize current(allocated_bytes += size);
+	++allocation_count;
+	VkDeviceSize peak(peak_allocated_bytes.load());
+	while (peak < current && !peak_allocated_bytes.compare_exchange_weak(peak, current)) {}
+}
+
+block_type::~block_type() {
+	if (data) {
+		vkUnmapMemory(device, memory);
+	}
+	vkFreeMemory(device, memory, NULL);
+	if (!pool) {
+		counters->freed(size);
+	}
+	counters->block_bytes -= size;
+	--counters->block_count;
+}
+
+allocator_type::allocator_type(VkDevice device,
+		const VkPhysicalDeviceMemoryProperties &memory_properties,
+		const VkPhysicalDeviceLimits &limits, bool dedicated_allocation)
+	: device(device), memory_properties(memory_properties),
+	  buffer_image_granularity(std::max(limits.bufferImageGranularity, VkDeviceSize(1))),
+	  non_coherent_atom_size(std::max(limits.nonCoherentAtomSize, VkDeviceSize(1))),
+	  counters(new heap_counters_type[memory_properties.memoryHeapCount]) {
+#ifdef VK_KHR_dedicated_allocation
+	get_buffer_memory_requirements2 = dedicated_allocation
+		? (PFN_vkGetBufferMemoryRequirements2KHR)vkGetDeviceProcAddr(device,
+			"vkGetBufferMemoryRequirements2KHR")
+		: nullptr;
+	get_image_memory_requirements2 = dedicated_allocation
+		? (PFN_vkGetImageMemoryRequirements2KHR)vkGetDeviceProcAddr(device,
+			"vkGetImageMemoryRequirements2KHR")
+		: nullptr;
+#endif  // VK_KHR_dedicated_allocation
+	pools.reserve(2 * memory_properties.memoryTypeCount);
+	for (uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i) {
+		// Small heaps, such as host visible device local memory, get 1/8th of the heap per block.
+		const VkDeviceSize heap_size(memory_properties.memoryHeaps[
+			memory_properties.memoryTypes[i].heapIndex].size);
+		const VkDeviceSize block_size(std::max(min_node_size,
+			floor_power_of_two(std::min(max_block_size, heap_size / 8))));
+		for (int linear = 0; linear < 2; ++linear) {
+			pools.emplace_back(new pool_type(i, block_size));
+		}
+	}
+}
+
+std::shared_ptr<block_type> allocator_type::allocate_block(uint32_t memoryTypeIndex,
+		VkDeviceSize size, pool_type *pool, const void *next) {
+	VkMemoryAllocateInfo allocate = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, next };
+	allocate.allocationSize = size;
+	allocate.memoryTypeIndex = memoryTypeIndex;
+	VkDeviceMemory memory;
+	const VkResult allocate_result(vkAllocateMemory(device, &allocate, NULL, &memory));
+	if (allocate_result == VK_ERROR_OUT_OF_DEVICE_MEMORY) {
+		return std::shared_ptr<block_type>();
+	}
+	VKCHECK(allocate_result);
+	void *data(nullptr);
+	if (memory_properties.memoryTypes[memoryTypeIndex].propertyFlags
+			& VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+		const VkResult result(vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &data));
+		if (result != VK_SUCCESS) {
+			vkFreeMemory(device, memory, NULL);
+			VKCHECK(result);
+		}
+	}
+	heap_counters_type &heap(counters[
+		memory_properties.memoryTypes[memoryTypeIndex].heapIndex]);
+	heap.block_bytes += size;
+	++heap.block_count;
+	if (!pool) {
+		heap.allocated(size);
+	}
+	return std::make_shared<block_type>(device, memory, size,
+		non_coherent_atom_size, pool, &heap, data);
+}
+
+std::vector<VkDeviceSize> allocator_type::largest_free() const {
+	std::vector<VkDeviceSize> largest(memory_properties.memoryHeapCount);
+	for (const std::unique_ptr<pool_type> &pool : pools) {
+		VkDeviceSize &heap(largest[
+			memory_properties.memoryTypes[pool->memoryTypeIndex].heapIndex]);
+		std::lock_guard<std::mutex> lock(pool->mutex);
+		for (const std::shared_ptr<block_type> &block : pool->blocks) {
+			heap = std::max(heap, block->buddy.largest_free());
+		}
+	}
+	return largest;
+}
+
+allocation_type allocator_type::allocate(VkDeviceSize size,
+		VkDeviceSize alignment, uint32_t memoryTypeIndex, bool linear) {
+	assert(memoryTypeIndex < memory_properties.memoryTypeCount);
+	pool_type &pool(*pools[2 * memoryTypeIndex + (linear ? 0 : 1)]);
+	if (std::max(size, alignment) > pool.block_size / 2) {
+		return allocation_type{ allocate_block(memoryTypeIndex, size, nullptr), 0 };
+	}
+	VkDeviceSize offset, node_size;
+	std::lock_guard<std::mutex> lock(pool.mutex);
+	for (const std::shared_ptr<block_type> &block : pool.blocks) {
+		if (block->buddy.allocate(size, alignment, &offset, &node_size)) {
+			block->counters->allocated(node_size);
+			return allocation_type{ block, offset };
+		}
+	}
+	std::shared_ptr<block_type> block(allocate_block(memoryTypeIndex,
+		pool.block_size, &pool));
+	if (!block) {
+		return allocation_type{ nullptr, 0 };
+	}
+	block->buddy = buddy_type(pool.block_size, min_node_size);
+	if (!block->buddy.allocate(size, alignment, &offset, &node_size)) {
+		throw vcc_exception("Allocation does not fit in an empty block");
+	}
+	block->counters->allocated(node_size);
+	pool.blocks.push_back(block);
+	return allocation_type{ std::move(block), offset };
+}
+
+allocation_type allocator_type::allocate_dedicated(VkDeviceSize size,
+		uint32_t memoryTypeIndex, VkBuffer buffer, VkImage image) {
+	assert(memoryTypeIndex < memory_properties.memoryTypeCount);
+#ifdef VK_KHR_dedicated_allocation
+	const VkMemoryDedicatedAllocateInfoKHR dedicated = {
+		VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO_KHR, NULL, image, buffer };
+	return allocation_type{ allocate_block(memoryTypeIndex, size, nullptr, &dedicated), 0 };
+#else
+	return allocation_type{ allocate_block(memoryTypeIndex, size, nullptr), 0 };
+#endif  // VK_KHR_dedicated_allocation
+}
+
+allocation_type allocator_type::allocate_denser(VkDeviceSize size,
+		VkDeviceSize alignment, const block_type &block) {
+	if (!block.pool) {
+		return allocation_type{ nullptr, 0 };
+	}
+	pool_type &pool(*block.pool);
+	std::lock_guard<std::mutex> lock(pool.mutex);
+	VkDeviceSize offset, node_size;
+	for (const std::shared_ptr<block_type> &candidate : pool.blocks) {
+		if (candidate.get() != &block
+				&& candidate->buddy.allocated_size() > block.buddy.allocated_size()
+				&& candidate->buddy.allocate(size, alignment, &offset, &node_size)) {
+			candidate->counters->allocated(node_size);
+			return allocation_type{ candidate, offset };
+		}
+	}
+	return allocation_type{ nullptr, 0 };
+}
+
+void free(const std::shared_ptr<block_type> &block, VkDeviceSize offset) {
+	pool_type *const pool(block->pool);
+	if (!pool) {
+		// Dedicated, freed along with the last reference.
+		return;
+	}
+	std::lock_guard<std::mutex> lock(pool->mutex);
+	block->counters->freed(block->buddy.free(offset));
+	if (block->buddy.empty() && pool->blocks.size() > 1) {
+		pool->blocks.erase(std::find(pool->blocks.begin(), pool->blocks.end(), block));
+	}
+}
+
+}  // namespace internal
+}  // namespace memory
+}  // namespace vcc
@@ -30,7 +30,8 @@ buffer_type create(const type::supplier<const device::device_type> &device,
 	create.pQueueFamilyIndices = queueFamilyIndices.empty() ? NULL : &queueFamilyIndices.front();
 	VkBuffer buffer;
 	VKCHECK(vkCreateBuffer(internal::get_instance(*device), &create, NULL, &buffer));
-	return buffer_type(buffer, device);
+	return buffer_type(buffer, device, create_info_type{ flags, size, usage,
+		sharingMode, queueFamilyIndices });
 }
 
 }  // namespace buffer
@@ -92,14 +92,15 @@ void cmd(build_type &build, const bind_descriptor_sets &bds) {
 	descriptor_sets.reserve(bds.descriptor_sets.size());
 	type::supplier<const pipeline_layout::pipeline_layout_type> layout(bds.layout);
 	internal::get_references(build).add(layout);
-	internal::get_pre_execute_callbacks(build).add([layout](const queue::queue_type &queue) {
+	internal::get_pre_execute_callbacks(build).add(*layout,
+			[layout](const queue::queue_type &queue) {
 		pipeline_layout::internal::get_pre_execute_callbacks(*layout)(queue);
 	});
 	for (const type::supplier<const descriptor_set::descriptor_set_type> &descriptor_set
 			: bds.descriptor_sets) {
 		descriptor_sets.push_back(vcc::internal::get_instance(*descriptor_set));
 		internal::get_references(build).add(descriptor_set);
-		internal::get_pre_execute_callbacks(build).add([descriptor_set](
+		internal::get_pre_execute_callbacks(build).add(*descriptor_set, [descriptor_set](
 				const queue::queue_type &queue) {
 			descriptor_set->pre_execute_callbacks(queue);
 		});
@@ -387,7 +388,8 @@ void cmd(build_type &build, const execute_commands &ec) {
 			: ec.commandBuffers) {
 		command_buffers.push_back(vcc::internal::get_instance(*command));
 		internal::get_references(build).add(command);
-		internal::get_pre_execute_callbacks(build).add([command](const queue::queue_type &queue) {
+		internal::get_pre_execute_callbacks(build).add(*command,
+				[command](const queue::queue_type &queue) {
 			command_buffer::internal::get_pre_execute_hook(*command)(queue);
 		});
 	}
@@ -397,8 +399,9 @@ void cmd(build_type &build, const execute_commands &ec) {
 
 void cmd(build_type &build, const bind_index_data_buffer_type&bidb) {
 	const type::supplier<const input_buffer::input_buffer_type> &buffer(bidb.buffer);
-	internal::get_pre_execute_callbacks(build).add([buffer](const queue::queue_type &queue) {
-		input_buffer::flush(queue, *buffer);
+	internal::get_pre_execute_callbacks(build).add(*buffer,
+			[buffer](const queue::queue_type &queue) {
+		input_buffer::flush_on_submit(queue, *buffer);
 	});
 	cmd(build, bind_index_buffer_type{ std::ref(input_buffer::internal::get_buffer(*buffer)),
 		bidb.offset, bidb.indexType });
@@ -408,8 +411,9 @@ void cmd(build_type &build, const bind_vertex_data_buffers_type&bvdb) {
 	std::vector<type::supplier<const buffer::buffer_type>> buffers;
 	buffers.reserve(bvdb.buffers.size());
 	for (const type::supplier<const input_buffer::input_buffer_type> &buffer : bvdb.buffers) {
-		internal::get_pre_execute_callbacks(build).add([buffer](const queue::queue_type &queue) {
-			input_buffer::flush(queue, *buffer);
+		internal::get_pre_execute_callbacks(build).add(*buffer,
+				[buffer](const queue::queue_type &queue) {
+			input_buffer::flush_on_submit(queue, *buffer);
 		});
 		buffers.push_back(std::ref(input_buffer::internal::get_buffer(*buffer)));
 	}
@@ -419,8 +423,9 @@ void cmd(build_type &build, const bind_vertex_data_buffers_type&bvdb) {
 
 void cmd(build_type &build, const draw_indirect_data_type&did) {
 	const type::supplier<const input_buffer::input_buffer_type> &buffer(did.buffer);
-	internal::get_pre_execute_callbacks(build).add([buffer](const queue::queue_type &queue) {
-		input_buffer::flush(queue, *buffer);
+	internal::get_pre_execute_callbacks(build).add(*buffer,
+			[buffer](const queue::queue_type &queue) {
+		input_buffer::flush_on_submit(queue, *buffer);
 	});
 	cmd(build, draw_indirect_type{ std::ref(input_buffer::internal::get_buffer(*buffer)),
 		did.offset, did.drawCount, did.stride });
@@ -428,8 +433,9 @@ void cmd(build_type &build, const draw_indirect_data_type&did) {
 
 void cmd(build_type &build, const draw_indexed_indirect_data_type&diid) {
 	const type::supplier<const input_buffer::input_buffer_type> &buffer(diid.buffer);
-	internal::get_pre_execute_callbacks(build).add([buffer](const queue::queue_type &queue) {
-		input_buffer::flush(queue, *buffer);
+	internal::get_pre_execute_callbacks(build).add(*buffer,
+			[buffer](const queue::queue_type &queue) {
+		input_buffer::flush_on_submit(queue, *buffer);
 	});
 	cmd(build, draw_indexed_indirect_type{ std::ref(input_buffer::internal::get_buffer(*buffer)),
 		diid.offset, diid.drawCount, diid.stride });
@@ -437,8 +443,9 @@ void cmd(build_type &build, const draw_indexed_indirect_data_type&diid) {
 
 void cmd(build_type &build, const dispatch_indirect_data_type&did) {
 	const type::supplier<const input_buffer::input_buffer_type> &buffer(did.buffer);
-	internal::get_pre_execute_callbacks(build).add([buffer](const queue::queue_type &queue) {
-		input_buffer::flush(queue, *buffer);
+	internal::get_pre_execute_callbacks(build).add(*buffer,
+			[buffer](const queue::queue_type &queue) {
+		input_buffer::flush_on_submit(queue, *buffer);
 	});
 	cmd(build, dispatch_indirect_type{ std::ref(input_buffer::internal::get_buffer(*buffer)),
 		did.offset });
@@ -446,8 +453,9 @@ void cmd(build_type &build, const dispatch_indirect_data_type&did) {
 
 void cmd(build_type &build, const copy_data_buffer_type&cdb) {
 	const type::supplier<const input_buffer::input_buffer_type> &buffer(cdb.srcBuffer);
-	internal::get_pre_execute_callbacks(build).add([buffer](const queue::queue_type &queue) {
-		input_buffer::flush(queue, *buffer);
+	internal::get_pre_execute_callbacks(build).add(*buffer,
+			[buffer](const queue::queue_type &queue) {
+		input_buffer::flush_on_submit(queue, *buffer);
 	});
 	cmd(build, copy_buffer_type{ std::ref(input_buffer::internal::get_buffer(*buffer)),
 		cdb.dstBuffer, cdb.regions });
@@ -455,8 +463,9 @@ void cmd(build_type &build, const copy_data_buffer_type&cdb) {
 
 void cmd(build_type &build, const copy_data_buffer_to_image_type&cdbti) {
 	const type::supplier<const input_buffer::input_buffer_type> &buffer(cdbti.srcBuffer);
-	internal::get_pre_execute_callbacks(build).add([buffer](const queue::queue_type &queue) {
-		input_buffer::flush(queue, *buffer);
+	internal::get_pre_execute_callbacks(build).add(*buffer,
+			[buffer](const queue::queue_type &queue) {
+		input_buffer::flush_on_submit(queue, *buffer);
 	});
 	cmd(build, copy_buffer_to_image_type{ std::ref(input_buffer::internal::get_buffer(*buffer)),
 		cdbti.dstImage, cdbti.dstImageLayout, cdbti.regions });
@@ -474,7 +483,14 @@ build_type::~build_type() {
 
 build_type::build_type(const type::supplier<command_buffer::command_buffer_type> &command_buffer)
 	: command_buffer(command_buffer),
-	command_buffer_lock(vcc::internal::get_mutex(*command_buffer)) {}
+	command_buffer_lock(vcc::internal::get_mutex(*command_buffer)),
+	pre_execute_callbacks(std::move(command_buffer->pre_execute_hook)),
+	references(std::move(command_buffer->references)) {
+	// A command buffer being recorded is not pending, so what the previous
+	// recording held on to is released. The memory is kept for this recording.
+	pre_execute_callbacks.clear();
+	references.clear();
+}
 
 build_type build(const type::supplier<command_buffer::command_buffer_type> &command_buffer,
 	VkCommandBufferUsageFlags flags,
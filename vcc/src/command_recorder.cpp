@@ -0,0 +1,166 @@
+/*
+* Copyright 2016 Google Inc. All Rights Reserved.
+
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+
+* http://www.apache.org/licenses/LICENSE-2.0
+
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <vcc/command_recorder.h>
+
+namespace vcc {
+namespace command_recorder {
+namespace internal {
+
+struct pools_type {
+	pools_type(const type::supplier<const device::device_type> &device,
+		uint32_t queue_family_index)
+		: device(device), queue_family_index(queue_family_index) {}
+
+	// Takes a pool no other task uses, creating one if there is none.
+	std::shared_ptr<command_pool::command_pool_type> acquire() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!free.empty()) {
+				std::shared_ptr<command_pool::command_pool_type> pool(std::move(free.back()));
+				free.pop_back();
+				return pool;
+			}
+		}
+		return std::make_shared<command_pool::command_pool_type>(command_pool::create(
+			device, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, queue_family_index));
+	}
+
+	void release(std::shared_ptr<command_pool::command_pool_type> &&pool) {
+		std::lock_guard<std::mutex> lock(mutex);
+		free.push_back(std::move(pool));
+	}
+
+	void clear() {
+		std::vector<std::shared_ptr<command_pool::command_pool_type>> released;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			released.swap(free);
+		}
+	}
+
+	const type::supplier<const device::device_type> device;
+	const uint32_t queue_family_index;
+	std::mutex mutex;
+	std::vector<std::shared_ptr<command_pool::command_pool_type>> free;
+};
+
+}  // namespace internal
+
+namespace {
+
+typedef std::function<command::build_type(
+	const type::supplier<command_buffer::command_buffer_type> &)> begin_function_type;
+
+command::execute_commands record(internal::pools_type &pools,
+		const type::executor_type &executor, std::size_t count, std::size_t chunk_size,
+		const begin_function_type &begin, const record_function_type &function) {
+	chunk_size = std::max(chunk_size, std::size_t(1));
+	const std::size_t chunks((count + chunk_size - 1) / chunk_size);
+	command::execute_commands commands;
+	commands.commandBuffers.resize(chunks);
+
+	std::mutex mutex;
+	std::condition_variable done;
+	std::size_t pending(chunks);
+	std::exception_ptr exception;
+	for (std::size_t chunk = 0; chunk < chunks; ++chunk) {
+		try {
+			executor([&, chunk]() {
+				try {
+					std::shared_ptr<command_pool::command_pool_type> pool(pools.acquire());
+					const std::shared_ptr<command_buffer::command_buffer_type> command_buffer(
+						std::make_shared<command_buffer::command_buffer_type>(
+							std::move(command_buffer::allocate(pools.device, pool,
+								VK_COMMAND_BUFFER_LEVEL_SECONDARY, 1).front())));
+					{
+						// Excludes command buffers of the pool being freed meanwhile.
+						std::lock_guard<std::mutex> pool_lock(vcc::internal::get_mutex(*pool));
+						command::build_type build(begin(command_buffer));
+						function(build, chunk * chunk_size,
+							std::min((chunk + 1) * chunk_size, count));
+					}
+					pools.release(std::move(pool));
+					commands.commandBuffers[chunk] = command_buffer;
+				} catch (...) {
+					std::lock_guard<std::mutex> lock(mutex);
+					if (!exception) {
+						exception = std::current_exception();
+					}
+				}
+				std::lock_guard<std::mutex> lock(mutex);
+				if (!--pending) {
+					done.notify_all();
+				}
+			});
+		} catch (...) {
+			// The chunks not handed over are not waited for.
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!exception) {
+				exception = std::current_exception();
+			}
+			pending -= chunks - chunk;
+			break;
+		}
+	}
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [&pending]() { return !pending; });
+	if (exception) {
+		std::rethrow_exception(exception);
+	}
+	return commands;
+}
+
+}  // anonymous namespace
+
+command_recorder_type create(const type::supplier<const device::device_type> &device,
+		uint32_t queueFamilyIndex) {
+	return command_recorder_type(std::make_shared<internal::pools_type>(device,
+		queueFamilyIndex));
+}
+
+command::execute_commands record(command_recorder_type &recorder,
+		const type::executor_type &executor, VkCommandBufferUsageFlags flags,
+		const type::supplier<const render_pass::render_pass_type> &render_pass,
+		uint32_t subpass,
+		const type::supplier<const framebuffer::framebuffer_type> &framebuffer,
+		std::size_t count, std::size_t chunk_size, const record_function_type &function) {
+	return record(*recorder.pools, executor, count, chunk_size,
+		[&](const type::supplier<command_buffer::command_buffer_type> &command_buffer) {
+		return command::build(command_buffer,
+			flags | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+			render_pass, subpass, framebuffer, VK_FALSE, 0, 0);
+	}, function);
+}
+
+command::execute_commands record(command_recorder_type &recorder,
+		const type::executor_type &executor, VkCommandBufferUsageFlags flags,
+		std::size_t count, std::size_t chunk_size, const record_function_type &function) {
+	return record(*recorder.pools, executor, count, chunk_size,
+		[&](const type::supplier<command_buffer::command_buffer_type> &command_buffer) {
+		return command::build(command_buffer, flags, VK_FALSE, 0, 0);
+	}, function);
+}
+
+void shrink(command_recorder_type &recorder) {
+	recorder.pools->clear();
+}
+
+}  // namespace command_recorder
+}  // namespace vcc
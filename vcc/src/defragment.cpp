@@ -0,0 +1,154 @@
+/*
+* Copyright 2016 Google Inc. All Rights Reserved.
+
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+
+* http://www.apache.org/licenses/LICENSE-2.0
+
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include <algorithm>
+#include <deque>
+#include <unordered_set>
+#include <vcc/defragment.h>
+#include <vcc/internal/prologue.h>
+#include <vcc/memory.h>
+
+namespace vcc {
+namespace defragment {
+
+void add(defragmenter_type &defragmenter,
+		const type::supplier<buffer::buffer_type> &buffer) {
+	std::lock_guard<std::mutex> lock(defragmenter.mutex);
+	defragmenter.buffers.push_back(buffer);
+}
+
+void add(defragmenter_type &defragmenter,
+		const type::supplier<descriptor_set::descriptor_set_type> &descriptor_set) {
+	std::lock_guard<std::mutex> lock(defragmenter.mutex);
+	defragmenter.descriptor_sets.push_back(descriptor_set);
+}
+
+void remove(defragmenter_type &defragmenter, const buffer::buffer_type &buffer) {
+	std::lock_guard<std::mutex> lock(defragmenter.mutex);
+	defragmenter.buffers.erase(std::remove_if(defragmenter.buffers.begin(),
+		defragmenter.buffers.end(),
+		[&buffer](const type::supplier<buffer::buffer_type> &registered) {
+			return &*registered == &buffer;
+		}), defragmenter.buffers.end());
+}
+
+void remove(defragmenter_type &defragmenter,
+		const descriptor_set::descriptor_set_type &descriptor_set) {
+	std::lock_guard<std::mutex> lock(defragmenter.mutex);
+	defragmenter.descriptor_sets.erase(std::remove_if(defragmenter.descriptor_sets.begin(),
+		defragmenter.descriptor_sets.end(),
+		[&descriptor_set](const type::supplier<descriptor_set::descriptor_set_type> &registered) {
+			return &*registered == &descriptor_set;
+		}), defragmenter.descriptor_sets.end());
+}
+
+namespace {
+
+const VkBufferUsageFlags transfer_usage(VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+	| VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+// Points the descriptors referencing any of the moved buffers at their new VkBuffer.
+void rewrite(const device::device_type &device,
+		const std::vector<type::supplier<descriptor_set::descriptor_set_type>> &descriptor_sets,
+		const std::unordered_set<const buffer::buffer_type *> &moved) {
+	std::vector<VkWriteDescriptorSet> writes;
+	// A deque keeps the infos in place while the writes point at them.
+	std::deque<VkDescriptorBufferInfo> infos;
+	std::vector<std::unique_lock<std::mutex>> locks;
+	for (const type::supplier<descriptor_set::descriptor_set_type> &descriptor_set
+			: descriptor_sets) {
+		std::unique_lock<std::mutex> lock(vcc::internal::get_mutex(*descriptor_set));
+		bool referenced(false);
+		for (const auto &descriptor : descriptor_set->buffer_descriptors) {
+			if (!moved.count(descriptor.second.buffer)) {
+				continue;
+			}
+			infos.push_back(VkDescriptorBufferInfo{
+				vcc::internal::get_instance(*descriptor.second.buffer),
+				descriptor.second.offset, descriptor.second.range });
+			writes.push_back(VkWriteDescriptorSet{ VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				NULL, vcc::internal::get_instance(*descriptor_set), descriptor.first.first,
+				descriptor.first.second, 1, descriptor.second.descriptor_type, NULL,
+				&infos.back(), NULL });
+			referenced = true;
+		}
+		if (referenced) {
+			locks.push_back(std::move(lock));
+		}
+	}
+	if (!writes.empty()) {
+		VKTRACE(vkUpdateDescriptorSets(vcc::internal::get_instance(device),
+			(uint32_t)writes.size(), writes.data(), 0, NULL));
+	}
+}
+
+}  // anonymous namespace
+
+std::vector<std::reference_wrapper<const buffer::buffer_type>> step(
+		defragmenter_type &defragmenter, const queue::queue_type &queue, VkDeviceSize budget) {
+	std::lock_guard<std::mutex> lock(defragmenter.mutex);
+	std::vector<std::reference_wrapper<const buffer::buffer_type>> moved;
+	std::unordered_set<const buffer::buffer_type *> moved_set;
+	VkDeviceSize moved_size(0);
+	for (std::size_t visited(0); visited < defragmenter.buffers.size(); ++visited) {
+		defragmenter.next %= defragmenter.buffers.size();
+		// Held by the prologue as the destination of the copy, so it must own
+		// the buffer: one added by reference may be destroyed before the submit.
+		const type::supplier<buffer::buffer_type> registered(
+			defragmenter.buffers[defragmenter.next]);
+		buffer::buffer_type &buffer(*registered);
+		if (!registered.owner() || !vcc::internal::get_instance(buffer) || !vcc::internal::get_memory(buffer)
+				|| (buffer::get_create_info(buffer).usage & transfer_usage) != transfer_usage
+				|| vcc::internal::get_offset(buffer) != 0) {
+			++defragmenter.next;
+			continue;
+		}
+		const VkMemoryRequirements requirements(
+			memory::internal::get_memory_requirements(buffer));
+		if (moved_size && moved_size + requirements.size > budget) {
+			// Picked up by the next step. The first move of a step is always
+			// made, so a buffer larger than the budget does not stall the others.
+			break;
+		}
+		++defragmenter.next;
+		const type::supplier<const memory::memory_type> target(
+			memory::internal::allocate_denser(*vcc::internal::get_memory(buffer),
+				requirements));
+		if (!target) {
+			continue;
+		}
+		const buffer::create_info_type &create_info(buffer::get_create_info(buffer));
+		buffer::buffer_type moved_buffer(buffer::create(
+			vcc::internal::get_parent(buffer), create_info.flags, create_info.size,
+			create_info.usage, create_info.sharingMode, create_info.queueFamilyIndices));
+		memory::internal::bind(target, 0, moved_buffer);
+		// The old buffer, and with it the old memory, lives until the copy has executed.
+		const std::shared_ptr<buffer::buffer_type> old(
+			std::make_shared<buffer::buffer_type>(std::move(buffer)));
+		buffer = std::move(moved_buffer);
+		queue::internal::get_prologue(queue)->copy(old, registered,
+			{ VkBufferCopy{ 0, 0, buffer::get_create_info(buffer).size } });
+		moved.push_back(std::cref(buffer));
+		moved_set.insert(&buffer);
+		moved_size += requirements.size;
+	}
+	if (!moved.empty()) {
+		rewrite(*vcc::internal::get_parent(queue), defragmenter.descriptor_sets, moved_set);
+	}
+	return moved;
+}
+
+}  // namespace defragment
+}  // namespace vcc
@@ -68,6 +68,15 @@ void add(update_storage &storage, const copy &c) {
 	storage.copy_sets.push_back(set);
 	for (uint32_t i = 0; i < c.descriptor_count; ++i) {
 		c.dst_set.references.clone(std::pair<uint32_t, uint32_t>{ c.dst_binding, uint32_t(c.dst_array_element + i) }, c.src_set.references);
+		const auto buffer(c.src_set.buffer_descriptors.find(std::pair<uint32_t, uint32_t>{
+			c.src_binding, uint32_t(c.src_array_element + i) }));
+		if (buffer != c.src_set.buffer_descriptors.end()) {
+			c.dst_set.buffer_descriptors[std::pair<uint32_t, uint32_t>{
+				c.dst_binding, uint32_t(c.dst_array_element + i) }] = buffer->second;
+		} else {
+			c.dst_set.buffer_descriptors.erase(std::pair<uint32_t, uint32_t>{
+				c.dst_binding, uint32_t(c.dst_array_element + i) });
+		}
 	}
 }
 
@@ -95,6 +104,8 @@ void add(update_storage &storage, const write_image &write) {
 		write.dst_set.references.put(std::pair<uint32_t, uint32_t>{
 			write.dst_binding, uint32_t(write.dst_array_element + i) },
 			write.images[i].sampler, write.images[i].image_view);
+		write.dst_set.buffer_descriptors.erase(std::pair<uint32_t, uint32_t>{
+			write.dst_binding, uint32_t(write.dst_array_element + i) });
 	}
 }
 
@@ -117,6 +128,10 @@ void add(update_storage &storage, const write_buffer_type &write) {
 		write.dst_set.references.put(
 			std::make_pair(write.dst_binding, uint32_t(write.dst_array_element + i)),
 			write.buffers[i].buffer);
+		write.dst_set.buffer_descriptors[std::make_pair(write.dst_binding,
+			uint32_t(write.dst_array_element + i))] = buffer_descriptor_type{
+				&*write.buffers[i].buffer, write.descriptor_type,
+				write.buffers[i].offset, write.buffers[i].range };
 	}
 }
 
@@ -131,7 +146,9 @@ void add(update_storage &storage, const write_buffer_data_type &wbdt) {
 		const type::supplier<const input_buffer::input_buffer_type> &buf(buffer.buffer);
 		wbdt.dst_set.pre_execute_callbacks.put(
 			std::make_pair(wbdt.dst_binding, uint32_t(wbdt.dst_array_element + i)),
-			[buf](const queue::queue_type &queue) { input_buffer::flush(queue, *buf); });
+			[buf](const queue::queue_type &queue) {
+				input_buffer::flush_on_submit(queue, *buf);
+			});
 	}
 	add(storage, write_buffer_type{ wbdt.dst_set, wbdt.dst_binding,
 		wbdt.dst_array_element, wbdt.descriptor_type,
@@ -156,6 +173,8 @@ void add(update_storage &storage, const write_buffer_view_type &write) {
 	for (uint32_t i = 0; i < write.buffers.size(); ++i) {
 		write.dst_set.references.put(std::make_pair(write.dst_binding, uint32_t(write.dst_array_element + i)),
 			write.buffers[i]);
+		write.dst_set.buffer_descriptors.erase(std::make_pair(write.dst_binding,
+			uint32_t(write.dst_array_element + i)));
 	}
 }
 
@@ -16,6 +16,8 @@
 #include <algorithm>
 #include <iterator>
 #include <vcc/device.h>
+#include <vcc/internal/allocator.h>
+#include <vcc/physical_device.h>
 
 namespace vcc {
 namespace device {
@@ -50,7 +52,12 @@ device_type create(VkPhysicalDevice physical_device, const std::vector<queue_cre
 	create_info.pEnabledFeatures = &features;
 	VkDevice device;
 	VKCHECK(vkCreateDevice(physical_device, &create_info, NULL, &device));
-	return device_type(device, physical_device);
+	return device_type(device, physical_device,
+		std::make_shared<memory::internal::allocator_type>(device,
+			physical_device::memory_properties(physical_device),
+			physical_device::properties(physical_device).limits,
+			extensions.count("VK_KHR_get_memory_requirements2")
+				&& extensions.count("VK_KHR_dedicated_allocation")));
 }
 
 void wait_idle(const device_type &device) {
@@ -49,8 +49,21 @@ image_type create(const type::supplier<const device::device_type> &device,
 	VkImage image;
 	VKCHECK(vkCreateImage(internal::get_instance(*device), &create, NULL, &image));
 	const VkDevice device_instance(internal::get_instance(*device));
-	return image_type(image, device, true, imageType, format, mipLevels,
-		arrayLayers);
+	return image_type(image, device, true, flags, imageType, format, extent, mipLevels,
+		arrayLayers, tiling);
+}
+
+std::vector<VkSparseImageMemoryRequirements> get_sparse_memory_requirements(
+		const image_type &image) {
+	const VkDevice device(internal::get_instance(*internal::get_parent(image)));
+	uint32_t count;
+	vkGetImageSparseMemoryRequirements(device, internal::get_instance(image), &count, NULL);
+	std::vector<VkSparseImageMemoryRequirements> requirements(count);
+	if (count) {
+		vkGetImageSparseMemoryRequirements(device, internal::get_instance(image), &count,
+			requirements.data());
+	}
+	return requirements;
 }
 
 VkSubresourceLayout get_subresource_layout(image_type &image,
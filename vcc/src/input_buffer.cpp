@@ -14,58 +14,186 @@
 * limitations under the License.
 */
 #define NOMINMAX
-#include <vcc/command.h>
-#include <vcc/command_buffer.h>
+#include <algorithm>
 #include <vcc/input_buffer.h>
+#include <vcc/internal/prologue.h>
 #include <vcc/memory.h>
 #include <vcc/queue.h>
 
 namespace vcc {
 namespace input_buffer {
+namespace internal {
+
+// Number of staging buffers a device local input buffer starts out with.
+const std::size_t staging_ring_size = 3;
+
+// A staging buffer and the prologue its last copy was queued on.
+struct staging_slot_type {
+	std::shared_ptr<buffer::buffer_type> buffer;
+	std::shared_ptr<queue::internal::prologue_type> prologue;
+	queue::internal::serial_type serial;
+};
+
+struct staging_type {
+	explicit staging_type(std::size_t size)
+		: shadow(size), slots(staging_ring_size), next(0) {}
+	staging_type(const staging_type &) = delete;
+	staging_type &operator=(const staging_type &) = delete;
+
+	// The serialized content of the whole buffer. Changed ranges are copied
+	// from here since the staging buffers hold the content of older flushes.
+	std::vector<uint8_t> shadow;
+	// Ring of staging buffers, slots[next] is the least recently used.
+	std::vector<staging_slot_type> slots;
+	std::size_t next;
+};
+
+}  // namespace internal
+
+namespace {
+
+bool host_visible(const buffer::buffer_type &buffer) {
+	return !!(memory::get_property_flags(*vcc::internal::get_memory(buffer))
+		& VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+}
+
+// Copies ranges of the shadow into staging_buffer.
+void write(const internal::staging_type &staging, const buffer::buffer_type &staging_buffer,
+		const std::vector<type::byte_range_type> &ranges) {
+	memory::map_type map(memory::map(vcc::internal::get_memory(staging_buffer),
+		vcc::internal::get_offset(staging_buffer), staging.shadow.size()));
+	for (const type::byte_range_type &range : ranges) {
+		std::copy(staging.shadow.begin() + range.offset,
+			staging.shadow.begin() + range.offset + range.size,
+			static_cast<uint8_t *>(map.data) + range.offset);
+	}
+	memory::flush(map, ranges);
+	memory::release(map);
+}
+
+// Serializes the changed ranges into the next staging buffer in the ring and
+// queues a copy to buffer on the prologue of the queue. If the previous copy
+// is still queued on that prologue, its staging buffer and copy are extended
+// instead. Must be called with the input buffer locked.
+bool upload(const queue::queue_type &queue, const type::serialize_type &serialize,
+		const buffer::buffer_type &buffer, internal::staging_type &staging) {
+	std::vector<type::byte_range_type> ranges;
+	type::flush(serialize, staging.shadow.data(), ranges);
+	if (ranges.empty()) {
+		return false;
+	}
+	std::vector<VkBufferCopy> regions;
+	regions.reserve(ranges.size());
+	for (const type::byte_range_type &range : ranges) {
+		regions.push_back(VkBufferCopy{ range.offset, range.offset, range.size });
+	}
+	const std::shared_ptr<queue::internal::prologue_type> prologue(
+		queue::internal::get_prologue(queue));
+	const internal::staging_slot_type &latest(
+		staging.slots[(staging.next + staging.slots.size() - 1) % staging.slots.size()]);
+	if (latest.prologue == prologue && prologue->amend(latest.serial, *latest.buffer, regions,
+			[&]() { write(staging, *latest.buffer, ranges); })) {
+		return true;
+	}
+	// Back to the nominal ring size once the slots grown into have been submitted,
+	// the prologue keeps their staging buffers alive until the copies have executed.
+	while (staging.slots.size() > internal::staging_ring_size
+			&& (!staging.slots[staging.next].prologue
+				|| staging.slots[staging.next].prologue->submitted(
+					staging.slots[staging.next].serial))) {
+		staging.slots.erase(staging.slots.begin() + staging.next);
+		if (staging.next == staging.slots.size()) {
+			staging.next = 0;
+		}
+	}
+	const type::supplier<const device::device_type> &device(
+		vcc::internal::get_parent(buffer));
+	if (staging.slots[staging.next].prologue
+			&& !staging.slots[staging.next].prologue->submitted(
+				staging.slots[staging.next].serial)) {
+		// Not submitted yet, such as when queued on another queue, so grow the
+		// ring instead of waiting for a submit.
+		staging.slots.insert(staging.slots.begin() + staging.next,
+			internal::staging_slot_type());
+	}
+	internal::staging_slot_type &slot(staging.slots[staging.next]);
+	staging.next = (staging.next + 1) % staging.slots.size();
+	if (slot.prologue) {
+		slot.prologue->wait(slot.serial);
+	} else {
+		slot.buffer = std::make_shared<buffer::buffer_type>(buffer::create(device, 0,
+			staging.shadow.size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_SHARING_MODE_EXCLUSIVE, {}));
+		memory::bind(device, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, *slot.buffer);
+	}
+	write(staging, *slot.buffer, ranges);
+	slot.prologue = prologue;
+	slot.serial = slot.prologue->copy(slot.buffer, std::ref(buffer), std::move(regions));
+	return true;
+}
+
+}  // anonymous namespace
 
 bool flush(const input_buffer_type &buffer) {
 	if (type::dirty(buffer.serialize)) {
 		std::unique_lock<std::mutex> lock(buffer.mutex);
 		if (type::dirty(buffer.serialize)) {
-			const memory::map_type map(memory::map(
+			if (!host_visible(buffer.buffer)) {
+				throw vcc_exception("input_buffer not in host visible memory must be flushed on a queue");
+			}
+			memory::map_type map(memory::map(
 				vcc::internal::get_memory(buffer.buffer),
 				vcc::internal::get_offset(buffer.buffer),
 				type::size(buffer.serialize)));
-			type::flush(buffer.serialize, (uint8_t *)map.data);
+			// Only the elements written since the last flush are serialized and flushed.
+			std::vector<type::byte_range_type> ranges;
+			type::flush(buffer.serialize, map.data, ranges);
+			memory::flush(map, ranges);
+			memory::release(map);
 			return true;
 		}
 	}
 	return false;
 }
 
-bool flush(const queue::queue_type &queue, const input_buffer_type &buffer) {
-	if (flush(buffer)) {
+bool flush_on_submit(const queue::queue_type &queue, const input_buffer_type &buffer) {
+	if (!host_visible(buffer.buffer)) {
+		if (!type::dirty(buffer.serialize)) {
+			return false;
+		}
 		std::unique_lock<std::mutex> lock(buffer.mutex);
-		type::supplier<const device::device_type> device(vcc::internal::get_parent(buffer.buffer));
-		command_pool::command_pool_type command_pool(command_pool::create(device,
-			VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, queue::get_family_index(queue)));
-		command_buffer::command_buffer_type command_buffer(std::move(command_buffer::allocate(
-			device, std::ref(command_pool), VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1).front()));
-		command::compile(
-			vcc::command::build(std::ref(command_buffer),
-				VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, VK_FALSE, 0, 0),
-			command::pipeline_barrier{ VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-				VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, {},
-				{
-					command::buffer_memory_barrier_type{
-						VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT,
-						VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
-						std::ref(buffer.buffer) }
-				}, {}
-			});
-		// Must block until our command finish executing.
-		fence::fence_type fence(vcc::fence::create(device));
-		queue::submit(queue, {}, { command_buffer }, {}, fence);
-		fence::wait(*device, { fence }, true);
-		return true;
+		if (!buffer.staging) {
+			buffer.staging = std::make_shared<internal::staging_type>(
+				type::size(buffer.serialize));
+		}
+		return upload(queue, buffer.serialize, buffer.buffer, *buffer.staging);
 	} else {
+		// Host writes are made visible to the device by vkQueueSubmit.
+		return flush(buffer);
+	}
+}
+
+bool flush(const queue::queue_type &queue, const input_buffer_type &buffer) {
+	if (host_visible(buffer.buffer)) {
+		return flush(buffer);
+	}
+	if (!flush_on_submit(queue, buffer)) {
 		return false;
 	}
+	std::shared_ptr<queue::internal::prologue_type> prologue;
+	queue::internal::serial_type serial;
+	{
+		std::unique_lock<std::mutex> lock(buffer.mutex);
+		const internal::staging_type &staging(*buffer.staging);
+		const internal::staging_slot_type &slot(
+			staging.slots[(staging.next + staging.slots.size() - 1) % staging.slots.size()]);
+		prologue = slot.prologue;
+		serial = slot.serial;
+	}
+	// Submits the copy on its own, unless a submit on another thread took it.
+	queue::submit(queue, {}, {}, {});
+	prologue->wait(serial);
+	return true;
 }
 
 }  // namespace input_buffer
@@ -13,25 +13,180 @@
 * See the License for the specific language governing permissions and
 * limitations under the License.
 */
+#include <algorithm>
+#include <sstream>
+#include <vcc/internal/allocator.h>
 #include <vcc/memory.h>
-#include <vcc/physical_device.h>
 
 namespace vcc {
 namespace memory {
 
+namespace {
+
+VkDeviceSize align(VkDeviceSize offset, VkDeviceSize alignment) {
+	return (offset + alignment - 1) / alignment * alignment;
+}
+
+// Rounds the range out to nonCoherentAtomSize, clamped to the block.
+VkMappedMemoryRange mapped_range(const internal::block_type &block,
+		VkDeviceSize offset, VkDeviceSize size) {
+	const VkDeviceSize atom(block.non_coherent_atom_size);
+	const VkDeviceSize begin(offset / atom * atom);
+	const VkDeviceSize end(std::min(align(offset + size, atom), block.size));
+	return VkMappedMemoryRange{ VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, nullptr,
+		block.memory, begin, end - begin };
+}
+
+// Ranks a memory type satisfying propertyFlags for an allocation of size bytes,
+// the highest score wins. Device local memory is preferred, for host visible
+// requests only if write_only and as long as the allocation takes a small share
+// of the heap and the heap stays at most half allocated, so uploads land in host
+// visible device local memory (BAR) without exhausting it while data read back
+// stays in host memory. Flags not asked for that cost something count against
+// a type, host caching only where the host does not read.
+int score(const internal::allocator_type &allocator, uint32_t memoryTypeIndex,
+		VkMemoryPropertyFlags propertyFlags, VkDeviceSize size, bool write_only) {
+	const VkPhysicalDeviceMemoryProperties &properties(allocator.memory_properties);
+	const VkMemoryType &type(properties.memoryTypes[memoryTypeIndex]);
+	const VkDeviceSize heap_size(properties.memoryHeaps[type.heapIndex].size);
+	const VkMemoryPropertyFlags extra(type.propertyFlags & ~propertyFlags);
+	int score(0);
+	if ((extra & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+			&& (!(propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+				|| (write_only && size <= heap_size / 8
+					&& allocator.counters[type.heapIndex].allocated_bytes + size
+						<= heap_size / 2))) {
+		score += 4;
+	}
+	if (extra & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+		// Leave it to those who need to map.
+		score -= 2;
+	}
+	if ((extra & VK_MEMORY_PROPERTY_HOST_CACHED_BIT)
+			&& (write_only || !(propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))) {
+		score -= 1;
+	}
+	if (extra & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) {
+		score -= 8;
+	}
+	return score;
+}
+
+// The usages through which the device may write a buffer.
+const VkBufferUsageFlags device_write_usage(VK_BUFFER_USAGE_TRANSFER_DST_BIT
+	| VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT);
+
+}  // anonymous namespace
+
+memory_type::memory_type(const std::shared_ptr<internal::block_type> &block,
+		const type::supplier<const device::device_type> &parent,
+		VkDeviceSize offset, VkDeviceSize size, VkMemoryType type)
+	: movable_with_parent(block->memory, parent), block(block), offset(offset),
+	  size(size), type(type) {}
+
+memory_type::~memory_type() {
+	if (block) {
+		internal::free(block, offset);
+	}
+}
+
 memory_type memory_type::allocate(const type::supplier<const device::device_type> &device,
-		VkDeviceSize allocationSize, uint32_t memoryTypeIndex, VkMemoryType type) {
-	VkMemoryAllocateInfo allocate = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, NULL};
-	allocate.allocationSize = allocationSize;
-	allocate.memoryTypeIndex = memoryTypeIndex;
-	VkDeviceMemory memory;
-	VKCHECK(vkAllocateMemory(vcc::internal::get_instance(*device), &allocate, NULL,
-		&memory));
-	return memory_type(memory, device, allocationSize, type);
+		VkMemoryPropertyFlags propertyFlags, const internal::requirements_type *requirements,
+		std::size_t count, VkDeviceSize *offsets) {
+	internal::allocator_type &allocator(device::get_allocator(*device));
+	const VkDeviceSize granularity(allocator.buffer_image_granularity);
+	bool mixed(false);
+	VkDeviceSize alignment(requirements[0].requirements.alignment);
+	uint32_t memoryTypeBits(requirements[0].requirements.memoryTypeBits);
+	bool write_only(requirements[0].write_only);
+	offsets[0] = 0;
+	for (std::size_t i = 1; i < count; ++i) {
+		VkDeviceSize resource_alignment(requirements[i].requirements.alignment);
+		if (requirements[i].linear != requirements[i - 1].linear) {
+			// Linear and non-linear neighbours must not share a granularity page.
+			resource_alignment = std::max(resource_alignment, granularity);
+			mixed = true;
+		}
+		offsets[i] = align(offsets[i - 1] + requirements[i - 1].requirements.size,
+			resource_alignment);
+		alignment = std::max(alignment, requirements[i].requirements.alignment);
+		memoryTypeBits &= requirements[i].requirements.memoryTypeBits;
+		write_only = write_only && requirements[i].write_only;
+	}
+	for (std::size_t i = 0; count > 1 && i < count; ++i) {
+		if (requirements[i].requires_dedicated) {
+			throw vcc_exception("Resource requiring a dedicated allocation must be bound alone");
+		}
+	}
+	VkDeviceSize size(offsets[count - 1] + requirements[count - 1].requirements.size);
+	if (!memoryTypeBits) {
+		throw vcc_exception("No memoryTypeBits for all given storage.");
+	}
+	if (mixed) {
+		// Occupy whole pages so it can live among either kind.
+		alignment = std::max(alignment, granularity);
+		size = align(size, granularity);
+	}
+	const VkPhysicalDeviceMemoryProperties &memory_properties(allocator.memory_properties);
+	// The types satisfying propertyFlags, best first. On equal scores the
+	// lower index, listed first by the driver, wins.
+	std::vector<std::pair<int, uint32_t>> candidates;
+	for (uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i) {
+		if ((memoryTypeBits & (1u << i))
+				&& (memory_properties.memoryTypes[i].propertyFlags & propertyFlags) == propertyFlags) {
+			candidates.emplace_back(-score(allocator, i, propertyFlags, size, write_only), i);
+		}
+	}
+	if (candidates.empty()) {
+		throw vcc_exception("Failed to find valid memoryTypeBits that fits the propertyFlags");
+	}
+	std::sort(candidates.begin(), candidates.end());
+	// A heap out of device memory, such as a small BAR heap, falls back to the next type.
+	for (const std::pair<int, uint32_t> &candidate : candidates) {
+		const uint32_t memoryTypeIndex(candidate.second);
+		const internal::allocation_type allocation(count == 1
+				&& (requirements[0].prefers_dedicated || requirements[0].requires_dedicated)
+			? allocator.allocate_dedicated(size, memoryTypeIndex, requirements[0].buffer,
+				requirements[0].image)
+			: allocator.allocate(size, alignment, memoryTypeIndex,
+				mixed || requirements[0].linear));
+		if (allocation.block) {
+			return memory_type(allocation.block, device, allocation.offset, size,
+				memory_properties.memoryTypes[memoryTypeIndex]);
+		}
+	}
+	throw vcc_exception("Out of device memory in all memory types that fit the propertyFlags");
+}
+
+type::supplier<const memory_type> allocate(
+		const type::supplier<const device::device_type> &device,
+		VkMemoryPropertyFlags propertyFlags, const VkMemoryRequirements &requirements) {
+	// Treated as non-linear, sparse pages are usually aligned to bufferImageGranularity anyway.
+	const internal::requirements_type resource = { requirements, false, false, false,
+		false, VK_NULL_HANDLE, VK_NULL_HANDLE };
+	VkDeviceSize offset;
+	return std::make_shared<memory_type>(memory_type::allocate(device, propertyFlags,
+		&resource, 1, &offset));
 }
 
 namespace internal {
 
+type::supplier<const memory_type> allocate_denser(const memory_type &memory,
+		const VkMemoryRequirements &requirements) {
+	if (memory.size != requirements.size) {
+		return type::supplier<const memory_type>();
+	}
+	const type::supplier<const device::device_type> &device(
+		vcc::internal::get_parent(memory));
+	const allocation_type allocation(device::get_allocator(*device).allocate_denser(
+		memory.size, requirements.alignment, *memory.block));
+	if (!allocation.block) {
+		return type::supplier<const memory_type>();
+	}
+	return std::make_shared<memory_type>(memory_type(allocation.block, device,
+		allocation.offset, memory.size, memory.type));
+}
+
 VkMemoryRequirements get_memory_requirements(const image::image_type &image) {
 	VkMemoryRequirements requirements;
 	vkGetImageMemoryRequirements(vcc::internal::get_instance(
@@ -47,7 +202,8 @@ void bind(const type::supplier<const memory_type> &memory, VkDeviceSize offset,
 		VKCHECK(vkBindImageMemory(
 			vcc::internal::get_instance(*vcc::internal::get_parent(image)),
 			vcc::internal::get_instance(image),
-			vcc::internal::get_instance(*memory), offset));
+			vcc::internal::get_instance(*memory),
+			vcc::internal::get_offset(*memory) + offset));
 	}
 	vcc::internal::get_memory(image) = memory;
 	vcc::internal::get_offset(image) = offset;
@@ -69,7 +225,8 @@ void bind(const type::supplier<const memory_type> &memory, VkDeviceSize offset,
 		VKCHECK(vkBindBufferMemory(
 			vcc::internal::get_instance(*vcc::internal::get_parent(buffer)),
 			vcc::internal::get_instance(buffer),
-			vcc::internal::get_instance(*memory), offset));
+			vcc::internal::get_instance(*memory),
+			vcc::internal::get_offset(*memory) + offset));
 	}
 	vcc::internal::get_memory(buffer) = memory;
 	vcc::internal::get_offset(buffer) = offset;
@@ -79,6 +236,66 @@ VkMemoryRequirements get_memory_requirements(const input_buffer::input_buffer_ty
 	return get_memory_requirements(input_buffer::internal::get_buffer(buffer));
 }
 
+requirements_type get_requirements(const image::image_type &image) {
+	const device::device_type &device(*vcc::internal::get_parent(image));
+	requirements_type requirements = { {},
+		image::get_tiling(image) == VK_IMAGE_TILING_LINEAR, false, false, false,
+		VK_NULL_HANDLE, vcc::internal::get_instance(image) };
+#ifdef VK_KHR_dedicated_allocation
+	const allocator_type &allocator(device::get_allocator(device));
+	if (allocator.get_image_memory_requirements2) {
+		VkMemoryDedicatedRequirementsKHR dedicated = {
+			VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS_KHR, NULL };
+		VkMemoryRequirements2KHR requirements2 = {
+			VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2_KHR, &dedicated };
+		const VkImageMemoryRequirementsInfo2KHR info = {
+			VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2_KHR, NULL,
+			requirements.image };
+		allocator.get_image_memory_requirements2(vcc::internal::get_instance(device),
+			&info, &requirements2);
+		requirements.requirements = requirements2.memoryRequirements;
+		requirements.prefers_dedicated = !!dedicated.prefersDedicatedAllocation;
+		requirements.requires_dedicated = !!dedicated.requiresDedicatedAllocation;
+		return requirements;
+	}
+#endif  // VK_KHR_dedicated_allocation
+	vkGetImageMemoryRequirements(vcc::internal::get_instance(device),
+		requirements.image, &requirements.requirements);
+	return requirements;
+}
+
+requirements_type get_requirements(const buffer::buffer_type &buffer) {
+	const device::device_type &device(*vcc::internal::get_parent(buffer));
+	requirements_type requirements = { {}, true,
+		!(buffer::get_create_info(buffer).usage & device_write_usage), false, false,
+		vcc::internal::get_instance(buffer), VK_NULL_HANDLE };
+#ifdef VK_KHR_dedicated_allocation
+	const allocator_type &allocator(device::get_allocator(device));
+	if (allocator.get_buffer_memory_requirements2) {
+		VkMemoryDedicatedRequirementsKHR dedicated = {
+			VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS_KHR, NULL };
+		VkMemoryRequirements2KHR requirements2 = {
+			VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2_KHR, &dedicated };
+		const VkBufferMemoryRequirementsInfo2KHR info = {
+			VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2_KHR, NULL,
+			requirements.buffer };
+		allocator.get_buffer_memory_requirements2(vcc::internal::get_instance(device),
+			&info, &requirements2);
+		requirements.requirements = requirements2.memoryRequirements;
+		requirements.prefers_dedicated = !!dedicated.prefersDedicatedAllocation;
+		requirements.requires_dedicated = !!dedicated.requiresDedicatedAllocation;
+		return requirements;
+	}
+#endif  // VK_KHR_dedicated_allocation
+	vkGetBufferMemoryRequirements(vcc::internal::get_instance(device),
+		requirements.buffer, &requirements.requirements);
+	return requirements;
+}
+
+requirements_type get_requirements(const input_buffer::input_buffer_type &buffer) {
+	return get_requirements(input_buffer::internal::get_buffer(buffer));
+}
+
 void bind(const type::supplier<const memory_type> &memory, VkDeviceSize offset,
 		input_buffer::input_buffer_type &buffer) {
 	bind(memory, offset, input_buffer::internal::get_buffer(buffer));
@@ -87,41 +304,104 @@ void bind(const type::supplier<const memory_type> &memory, VkDeviceSize offset,
 }  // namespace internal
 
 map_type::~map_type() {
-	if (memory) {
-		std::lock_guard<std::mutex> lock(vcc::internal::get_mutex(*memory));
-		vkUnmapMemory(
-			vcc::internal::get_instance(*vcc::internal::get_parent(*memory)),
-			vcc::internal::get_instance(*memory));
-		if (!(memory->type.propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
-			flush(*memory, offset, size);
-		}
+	if (memory && size && flush_on_destroy
+			&& !(memory->type.propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+		flush(*memory, offset, size);
 	}
 }
 
 map_type map(const type::supplier<const memory_type> &memory, VkDeviceSize offset,
 		VkDeviceSize size) {
-	void *data;
-	{
-		std::lock_guard<std::mutex> lock(vcc::internal::get_mutex(*memory));
-		VKCHECK(vkMapMemory(
-			vcc::internal::get_instance(*vcc::internal::get_parent(*memory)),
-			vcc::internal::get_instance(*memory), offset, size, 0, &data));
+	const internal::block_type &block(*memory->block);
+	if (!block.data) {
+		throw vcc_exception("Memory is not host visible");
+	}
+	if (size == VK_WHOLE_SIZE) {
+		size = memory->size - offset;
 	}
-	return map_type(memory, offset, size, data);
+	return map_type(memory, offset, size,
+		static_cast<uint8_t *>(block.data) + memory->offset + offset);
 }
 
 void flush(const memory_type &memory, VkDeviceSize offset, VkDeviceSize size) {
-	VkMappedMemoryRange range = { VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, nullptr,
-		vcc::internal::get_instance(memory), offset, size };
-	VKCHECK(vkFlushMappedMemoryRanges(
-		vcc::internal::get_instance(*vcc::internal::get_parent(memory)), 1, &range));
+	if (size == VK_WHOLE_SIZE) {
+		size = memory.size - offset;
+	}
+	const VkMappedMemoryRange range(mapped_range(*memory.block,
+		memory.offset + offset, size));
+	VKCHECK(vkFlushMappedMemoryRanges(memory.block->device, 1, &range));
+}
+
+void flush(map_type &map, const std::vector<type::byte_range_type> &ranges) {
+	const memory_type &memory(*map.memory);
+	if (!ranges.empty()
+			&& !(memory.type.propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+		std::vector<VkMappedMemoryRange> mapped_ranges;
+		mapped_ranges.reserve(ranges.size());
+		for (const type::byte_range_type &range : ranges) {
+			mapped_ranges.push_back(mapped_range(*memory.block,
+				memory.offset + map.offset + range.offset, range.size));
+		}
+		VKCHECK(vkFlushMappedMemoryRanges(memory.block->device,
+			uint32_t(mapped_ranges.size()), mapped_ranges.data()));
+	}
 }
 
 void invalidate(const memory_type &memory, VkDeviceSize offset, VkDeviceSize size) {
-	VkMappedMemoryRange range = { VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, nullptr,
-		vcc::internal::get_instance(memory), offset, size };
-	VKCHECK(vkInvalidateMappedMemoryRanges(
-		vcc::internal::get_instance(*vcc::internal::get_parent(memory)), 1, &range));
+	if (size == VK_WHOLE_SIZE) {
+		size = memory.size - offset;
+	}
+	const VkMappedMemoryRange range(mapped_range(*memory.block,
+		memory.offset + offset, size));
+	VKCHECK(vkInvalidateMappedMemoryRanges(memory.block->device, 1, &range));
+}
+
+std::vector<heap_statistics_type> statistics(const device::device_type &device) {
+	const internal::allocator_type &allocator(device::get_allocator(device));
+	const std::vector<VkDeviceSize> largest_free(allocator.largest_free());
+	std::vector<heap_statistics_type> heaps;
+	heaps.reserve(allocator.memory_properties.memoryHeapCount);
+	for (uint32_t i = 0; i < allocator.memory_properties.memoryHeapCount; ++i) {
+		const internal::heap_counters_type &counters(allocator.counters[i]);
+		heap_statistics_type heap;
+		heap.heap_size = allocator.memory_properties.memoryHeaps[i].size;
+		heap.flags = allocator.memory_properties.memoryHeaps[i].flags;
+		heap.block_count = counters.block_count;
+		heap.block_bytes = counters.block_bytes;
+		heap.allocation_count = counters.allocation_count;
+		heap.allocated_bytes = counters.allocated_bytes;
+		heap.peak_allocated_bytes = counters.peak_allocated_bytes;
+		heap.largest_free_block = largest_free[i];
+		const VkDeviceSize free_bytes(heap.block_bytes > heap.allocated_bytes
+			? heap.block_bytes - heap.allocated_bytes : 0);
+		heap.fragmentation = free_bytes
+			? 1.f - float(std::min(heap.largest_free_block, free_bytes)) / float(free_bytes)
+			: 0.f;
+		heaps.push_back(heap);
+	}
+	return heaps;
+}
+
+std::string dump_statistics(const device::device_type &device) {
+	std::ostringstream stream;
+	stream << '[';
+	const std::vector<heap_statistics_type> heaps(statistics(device));
+	for (std::size_t i = 0; i < heaps.size(); ++i) {
+		const heap_statistics_type &heap(heaps[i]);
+		stream << (i ? "," : "") << "{\"heap\":" << i
+			<< ",\"heap_size\":" << heap.heap_size
+			<< ",\"device_local\":"
+			<< (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT ? "true" : "false")
+			<< ",\"block_count\":" << heap.block_count
+			<< ",\"block_bytes\":" << heap.block_bytes
+			<< ",\"allocation_count\":" << heap.allocation_count
+			<< ",\"allocated_bytes\":" << heap.allocated_bytes
+			<< ",\"peak_allocated_bytes\":" << heap.peak_allocated_bytes
+			<< ",\"largest_free_block\":" << heap.largest_free_block
+			<< ",\"fragmentation\":" << heap.fragmentation << '}';
+	}
+	stream << ']';
+	return stream.str();
 }
 
 }  // namespace memory
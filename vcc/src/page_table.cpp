@@ -0,0 +1,221 @@
+/*
+* Copyright 2016 Google Inc. All Rights Reserved.
+
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+
+* http://www.apache.org/licenses/LICENSE-2.0
+
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#define NOMINMAX
+#include <algorithm>
+#include <unordered_set>
+#include <vcc/page_table.h>
+
+namespace vcc {
+namespace page_table {
+
+namespace {
+
+// Pages allocated at once as residency grows.
+const uint32_t chunk_pages = 64;
+
+uint32_t mip_size(uint32_t size, uint32_t mip_level) {
+	return std::max(size >> mip_level, 1u);
+}
+
+uint32_t tile_count(uint32_t size, uint32_t granularity) {
+	return (size + granularity - 1) / granularity;
+}
+
+bool valid(const image::image_type &image,
+		const VkSparseImageMemoryRequirements &sparse_requirements, const tile_type &tile) {
+	const VkExtent3D &extent(image::get_extent(image));
+	const VkExtent3D &granularity(sparse_requirements.formatProperties.imageGranularity);
+	return tile.mip_level < sparse_requirements.imageMipTailFirstLod
+		&& tile.mip_level < image::get_mip_levels(image)
+		&& tile.array_layer < image::get_array_layers(image)
+		&& tile.x < tile_count(mip_size(extent.width, tile.mip_level), granularity.width)
+		&& tile.y < tile_count(mip_size(extent.height, tile.mip_level), granularity.height)
+		&& tile.z < tile_count(mip_size(extent.depth, tile.mip_level), granularity.depth);
+}
+
+// Tiles are at most 2^16 per dimension, mip levels 32 and array layers 2^11.
+uint64_t key(const tile_type &tile) {
+	return uint64_t(tile.mip_level) << 59 | uint64_t(tile.array_layer) << 48
+		| uint64_t(tile.z) << 32 | uint64_t(tile.y) << 16 | uint64_t(tile.x);
+}
+
+tile_type tile(uint64_t key) {
+	return tile_type{ uint32_t(key >> 59), uint32_t(key >> 48) & 0x7ff,
+		uint32_t(key) & 0xffff, uint32_t(key >> 16) & 0xffff, uint32_t(key >> 32) & 0xffff };
+}
+
+}  // anonymous namespace
+
+page_table_type create(const type::supplier<const image::image_type> &image,
+		const queue::queue_type &queue, VkDeviceSize budget, uint32_t keep_updates,
+		VkMemoryPropertyFlags propertyFlags) {
+	if (!(image::get_flags(*image) & VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT)) {
+		throw vcc_exception("page_table requires an image with VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT");
+	}
+	const type::supplier<const device::device_type> &device(
+		vcc::internal::get_parent(*image));
+	page_table_type table;
+	table.image = image;
+	table.property_flags = propertyFlags;
+	table.requirements = memory::internal::get_memory_requirements(*image);
+	table.keep_updates = keep_updates;
+	table.updates = 0;
+	const std::vector<VkSparseImageMemoryRequirements> sparse_requirements(
+		image::get_sparse_memory_requirements(*image));
+	queue::sparse_image_opaque_bind_type mip_tail_binds{ std::cref(*image), {} };
+	bool found(false);
+	VkDeviceSize mip_tails_size(0);
+	for (const VkSparseImageMemoryRequirements &requirements : sparse_requirements) {
+		const bool metadata(!!(requirements.formatProperties.aspectMask
+			& VK_IMAGE_ASPECT_METADATA_BIT));
+		if (!metadata && !found) {
+			table.sparse_requirements = requirements;
+			found = true;
+		}
+		if (requirements.imageMipTailFirstLod >= image::get_mip_levels(*image)
+				&& !metadata) {
+			continue;
+		}
+		const uint32_t mip_tails((requirements.formatProperties.flags
+				& VK_SPARSE_IMAGE_FORMAT_SINGLE_MIPTAIL_BIT)
+			? 1 : image::get_array_layers(*image));
+		for (uint32_t layer = 0; layer < mip_tails; ++layer) {
+			table.mip_tails.push_back(memory::allocate(device, propertyFlags,
+				VkMemoryRequirements{ requirements.imageMipTailSize,
+					table.requirements.alignment, table.requirements.memoryTypeBits }));
+			mip_tail_binds.binds.push_back(queue::sparse_memory_bind_type{
+				requirements.imageMipTailOffset + layer * requirements.imageMipTailStride,
+				requirements.imageMipTailSize, table.mip_tails.back(), 0,
+				VkSparseMemoryBindFlags(metadata ? VK_SPARSE_MEMORY_BIND_METADATA_BIT : 0) });
+			mip_tails_size += requirements.imageMipTailSize;
+		}
+	}
+	if (!found) {
+		throw vcc_exception("Image has no sparse memory requirements");
+	}
+	if (budget < mip_tails_size + table.requirements.alignment) {
+		throw vcc_exception("page_table budget does not cover the mip tail and a tile");
+	}
+	table.max_pages = uint32_t(std::min<VkDeviceSize>(
+		(budget - mip_tails_size) / table.requirements.alignment, UINT32_MAX));
+	if (!mip_tail_binds.binds.empty()) {
+		queue::bind_sparse_info_type info;
+		info.image_opaque_binds.push_back(std::move(mip_tail_binds));
+		queue::bind_sparse(queue, info);
+	}
+	return table;
+}
+
+std::vector<tile_type> update(page_table_type &table,
+		const queue::queue_type &queue, const std::vector<tile_type> &feedback,
+		const std::vector<std::reference_wrapper<const semaphore::semaphore_type>> &wait_semaphores,
+		const std::vector<std::reference_wrapper<const semaphore::semaphore_type>> &signal_semaphores) {
+	const image::image_type &image(*table.image);
+	const uint64_t update(++table.updates);
+	std::vector<uint64_t> missing;
+	std::unordered_set<uint64_t> requested;
+	for (const tile_type &tile : feedback) {
+		if (!valid(image, table.sparse_requirements, tile)) {
+			continue;
+		}
+		const uint64_t tile_key(key(tile));
+		const auto it(table.resident.find(tile_key));
+		if (it != table.resident.end()) {
+			it->second.requested = update;
+		} else if (requested.insert(tile_key).second) {
+			missing.push_back(tile_key);
+		}
+	}
+	std::vector<tile_type> committed;
+	// Tiles not requested recently enough, least recently requested first.
+	std::vector<std::pair<uint64_t, uint64_t>> evictable;
+	const std::size_t allocated_pages(table.chunks.size() * chunk_pages);
+	if (allocated_pages - table.free_pages.size() + missing.size() > table.max_pages) {
+		for (const auto &entry : table.resident) {
+			if (entry.second.requested + table.keep_updates <= update) {
+				evictable.emplace_back(entry.second.requested, entry.first);
+			}
+		}
+		std::sort(evictable.begin(), evictable.end());
+	}
+	const VkDeviceSize page_size(table.requirements.alignment);
+	const VkExtent3D &extent(image::get_extent(image));
+	const VkExtent3D &granularity(table.sparse_requirements.formatProperties.imageGranularity);
+	const VkImageAspectFlags aspect(table.sparse_requirements.formatProperties.aspectMask);
+	queue::sparse_image_bind_type binds{ std::cref(image), {} };
+	const auto bind([&](uint64_t tile_key, const type::supplier<const memory::memory_type> &memory,
+			VkDeviceSize memory_offset) {
+		const tile_type bound(tile(tile_key));
+		const VkOffset3D offset{ int32_t(bound.x * granularity.width),
+			int32_t(bound.y * granularity.height), int32_t(bound.z * granularity.depth) };
+		// Tiles along the edges of a mip level are clipped to it.
+		binds.binds.push_back(queue::sparse_image_memory_bind_type{
+			VkImageSubresource{ aspect, bound.mip_level, bound.array_layer }, offset,
+			VkExtent3D{
+				std::min(granularity.width, mip_size(extent.width, bound.mip_level) - offset.x),
+				std::min(granularity.height, mip_size(extent.height, bound.mip_level) - offset.y),
+				std::min(granularity.depth, mip_size(extent.depth, bound.mip_level) - offset.z) },
+			memory, memory_offset, 0 });
+	});
+	std::size_t evicted(0);
+	for (uint64_t tile_key : missing) {
+		uint32_t page;
+		if (!table.free_pages.empty()) {
+			page = table.free_pages.back();
+			table.free_pages.pop_back();
+		} else if (table.chunks.size() * chunk_pages < table.max_pages) {
+			const uint32_t first(uint32_t(table.chunks.size() * chunk_pages));
+			const uint32_t pages(std::min(chunk_pages, table.max_pages - first));
+			table.chunks.push_back(memory::allocate(vcc::internal::get_parent(image),
+				table.property_flags, VkMemoryRequirements{ pages * page_size, page_size,
+					table.requirements.memoryTypeBits }));
+			for (uint32_t i = pages; i > 1; --i) {
+				table.free_pages.push_back(first + i - 1);
+			}
+			page = first;
+		} else if (evicted < evictable.size()) {
+			const auto it(table.resident.find(evictable[evicted++].second));
+			page = it->second.page;
+			// Unbound ahead of the bind reusing its page.
+			bind(it->first, type::supplier<const memory::memory_type>(), 0);
+			table.resident.erase(it);
+		} else {
+			// Out of budget, the rest is requested again by later feedback.
+			break;
+		}
+		bind(tile_key, table.chunks[page / chunk_pages], (page % chunk_pages) * page_size);
+		table.resident.emplace(tile_key, page_table_type::entry_type{ page, update });
+		committed.push_back(tile(tile_key));
+	}
+	// Submitted even without binds, so the semaphores are waited for and signaled.
+	if (!binds.binds.empty() || !wait_semaphores.empty() || !signal_semaphores.empty()) {
+		queue::bind_sparse_info_type info;
+		info.wait_semaphores = wait_semaphores;
+		if (!binds.binds.empty()) {
+			info.image_binds.push_back(std::move(binds));
+		}
+		info.signal_semaphores = signal_semaphores;
+		queue::bind_sparse(queue, info);
+	}
+	return committed;
+}
+
+bool is_resident(const page_table_type &table, const tile_type &tile) {
+	return table.resident.count(key(tile)) != 0;
+}
+
+}  // namespace page_table
+}  // namespace vcc
@@ -19,6 +19,7 @@
 #include <iterator>
 #include <vcc/command.h>
 #include <vcc/command_buffer.h>
+#include <vcc/internal/transient.h>
 #include <vcc/queue.h>
 #include <vcc/pipeline_layout.h>
 
@@ -48,21 +49,22 @@ pipeline_layout_type create(const type::supplier<const device::device_type> &dev
 
 namespace internal {
 
-void flush(const type::supplier<const type::serialize_type> &constants,
+bool update(constants_type &constants) {
+	if (!type::dirty(constants.serialize)) {
+		return false;
+	}
+	type::flush(constants.serialize, &constants.buffer[0]);
+	return true;
+}
+
+void flush(const std::shared_ptr<constants_type> &constants,
 		VkPipelineLayout pipeline_layout,
 		const std::vector<VkPushConstantRange> &push_constant_ranges,
 		const queue::queue_type &queue) {
-	if (type::dirty(*constants)) {
-		const type::supplier<const device::device_type> device(
-			vcc::internal::get_parent(queue));
-		std::string buffer(type::size(*constants), '\0');
-		type::flush(*constants, &buffer[0]);
-		command_pool::command_pool_type command_pool(command_pool::create(
-			device, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, queue::get_family_index(queue)));
-		command_buffer::command_buffer_type cmd(std::move(
-			command_buffer::allocate(device, std::ref(command_pool),
-				VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1).front()));
-		{
+	if (update(*constants)) {
+		const std::string &buffer(constants->buffer);
+		// Must block until our command finish executing.
+		queue::internal::execute(queue, [&](command_buffer::command_buffer_type &cmd) {
 			command::build_type begin(command::build(
 				std::ref(cmd), VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
 				VK_FALSE, 0, 0));
@@ -72,11 +74,7 @@ void flush(const type::supplier<const type::serialize_type> &constants,
 					range.stageFlags, range.offset, range.size,
 					&buffer[range.offset]);
 			}
-		}
-		// Must block until our command finish executing.
-		fence::fence_type fence(fence::create(device));
-		queue::submit(queue, {}, { cmd }, {}, fence);
-		fence::wait(*device, { fence }, true, std::chrono::nanoseconds::max());
+		});
 	}
 }
 
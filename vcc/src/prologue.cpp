@@ -0,0 +1,210 @@
+/*
+* Copyright 2016 Google Inc. All Rights Reserved.
+
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+
+* http://www.apache.org/licenses/LICENSE-2.0
+
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include <algorithm>
+#include <set>
+#include <vcc/command.h>
+#include <vcc/internal/prologue.h>
+
+namespace vcc {
+namespace queue {
+namespace internal {
+
+namespace {
+
+// Sorts regions and merges those overlapping or adjacent, since the
+// destination regions of a copy must not overlap. Source and destination
+// offsets are equal for the copies of the prologue.
+void merge(std::vector<VkBufferCopy> &regions) {
+	std::sort(regions.begin(), regions.end(),
+		[](const VkBufferCopy &a, const VkBufferCopy &b) {
+			return a.srcOffset < b.srcOffset;
+		});
+	std::size_t merged(0);
+	for (std::size_t i = 1; i < regions.size(); ++i) {
+		VkBufferCopy &last(regions[merged]);
+		if (regions[i].srcOffset <= last.srcOffset + last.size) {
+			last.size = std::max(last.size,
+				regions[i].srcOffset + regions[i].size - last.srcOffset);
+		} else {
+			regions[++merged] = regions[i];
+		}
+	}
+	regions.resize(std::min(regions.size(), merged + 1));
+}
+
+}  // anonymous namespace
+
+prologue_type::~prologue_type() {
+	std::vector<std::reference_wrapper<const fence::fence_type>> fences;
+	for (const std::unique_ptr<frame_type> &frame : frames) {
+		if (frame->serial && frame->serial <= submitted_serial) {
+			fences.push_back(std::cref(frame->fence));
+		}
+	}
+	if (!fences.empty()) {
+		fence::wait(*device, fences, true);
+	}
+}
+
+serial_type prologue_type::copy(const type::supplier<const buffer::buffer_type> &src,
+		const type::supplier<const buffer::buffer_type> &dst,
+		std::vector<VkBufferCopy> &&regions) {
+	std::lock_guard<std::mutex> lock(mutex);
+	copies.push_back(copy_type{ src, dst, std::move(regions) });
+	return next_serial;
+}
+
+bool prologue_type::amend(serial_type serial, const buffer::buffer_type &src,
+		const std::vector<VkBufferCopy> &regions, const std::function<void()> &write) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (serial != next_serial) {
+		return false;
+	}
+	const auto it(std::find_if(copies.begin(), copies.end(), [&src](const copy_type &copy) {
+		return &*copy.src == &src;
+	}));
+	if (it == copies.end()) {
+		return false;
+	}
+	write();
+	it->regions.insert(it->regions.end(), regions.begin(), regions.end());
+	merge(it->regions);
+	return true;
+}
+
+bool prologue_type::submitted(serial_type serial) {
+	std::lock_guard<std::mutex> lock(mutex);
+	return serial <= submitted_serial;
+}
+
+void prologue_type::wait(serial_type serial) {
+	frame_type *frame;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (serial > submitted_serial) {
+			return;
+		}
+		// The copies of a failed submit are recorded in a later prologue.
+		const auto it(std::find_if(frames.begin(), frames.end(),
+			[serial](const std::unique_ptr<frame_type> &frame) {
+				return frame->serial >= serial;
+			}));
+		// A frame no longer holding the serial has been recycled, so it has finished.
+		if (it == frames.end() || (*it)->serial > submitted_serial) {
+			return;
+		}
+		// Frames are only destroyed with the prologue, a waiter keeps it from being recycled.
+		frame = it->get();
+		++frame->waiters;
+	}
+	try {
+		fence::wait(*device, { frame->fence }, true);
+	} catch (...) {
+		std::lock_guard<std::mutex> lock(mutex);
+		--frame->waiters;
+		throw;
+	}
+	std::lock_guard<std::mutex> lock(mutex);
+	--frame->waiters;
+}
+
+prologue_type::frame_type &prologue_type::acquire_frame() {
+	if (!frames.empty() && (!frames.front()->serial
+			|| (frames.front()->serial <= submitted_serial
+				&& !frames.front()->waiters
+				&& vkGetFenceStatus(vcc::internal::get_instance(*device),
+					vcc::internal::get_instance(frames.front()->fence)) == VK_SUCCESS))) {
+		frames.push_back(std::move(frames.front()));
+		frames.pop_front();
+		fence::reset(*device, { frames.back()->fence });
+	} else {
+		std::unique_ptr<frame_type> frame(new frame_type());
+		frame->command_pool = command_pool::create(device,
+			VK_COMMAND_POOL_CREATE_TRANSIENT_BIT
+				| VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+			family_index);
+		frame->command_buffer = std::move(command_buffer::allocate(device,
+			std::ref(frame->command_pool), VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1).front());
+		frame->fence = fence::create(device);
+		frame->waiters = 0;
+		frames.push_back(std::move(frame));
+	}
+	return *frames.back();
+}
+
+VkCommandBuffer prologue_type::record(VkFence *fence) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (copies.empty()) {
+		return VK_NULL_HANDLE;
+	}
+	frame_type &frame(acquire_frame());
+	frame.serial = next_serial++;
+	{
+		// The command buffer keeps the staging buffers referenced until it is recorded again.
+		command::build_type build(command::build(std::ref(frame.command_buffer),
+			VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, VK_FALSE, 0, 0));
+		// Earlier submissions may still read the buffers being overwritten.
+		command::internal::cmd(build, command::pipeline_barrier(
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			{}, {}, {}));
+		std::set<VkBuffer> written;
+		for (copy_type &copy : copies) {
+			if (!written.insert(vcc::internal::get_instance(*copy.dst)).second) {
+				// The same buffer flushed twice, the later copy must land last.
+				command::internal::cmd(build, command::pipeline_barrier(
+					VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+					{ command::memory_barrier{ VK_ACCESS_TRANSFER_WRITE_BIT,
+						VK_ACCESS_TRANSFER_WRITE_BIT } }, {}, {}));
+				written.clear();
+				written.insert(vcc::internal::get_instance(*copy.dst));
+			}
+			command::internal::cmd(build, command::copy_buffer_type{
+				copy.src, copy.dst, copy.regions });
+		}
+		command::internal::cmd(build, command::pipeline_barrier(
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+			{ command::memory_barrier{ VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_ACCESS_MEMORY_READ_BIT } }, {}, {}));
+	}
+	frame.copies.swap(copies);
+	copies.clear();
+	*fence = vcc::internal::get_instance(frame.fence);
+	return vcc::internal::get_instance(frame.command_buffer);
+}
+
+void prologue_type::submitted() {
+	std::lock_guard<std::mutex> lock(mutex);
+	submitted_serial = frames.back()->serial;
+	// The command buffer keeps the buffers referenced.
+	frames.back()->copies.clear();
+}
+
+void prologue_type::failed() {
+	std::lock_guard<std::mutex> lock(mutex);
+	std::unique_ptr<frame_type> frame(std::move(frames.back()));
+	frames.pop_back();
+	// Ahead of the copies queued since, which may overwrite the same ranges.
+	copies.insert(copies.begin(), std::make_move_iterator(frame->copies.begin()),
+		std::make_move_iterator(frame->copies.end()));
+	frame->copies.clear();
+	// Its fence is not signaled, but it was never submitted either.
+	frame->serial = 0;
+	frames.push_front(std::move(frame));
+}
+
+}  // namespace internal
+}  // namespace queue
+}  // namespace vcc
@@ -14,7 +14,14 @@
 * limitations under the License.
 */
 #define NOMINMAX
+#include <algorithm>
 #include <limits>
+#include <memory>
+#include <mutex>
+#include <type/registry.h>
+#include <vcc/internal/prologue.h>
+#include <vcc/internal/transient.h>
+#include <vcc/memory.h>
 #include <vcc/physical_device.h>
 #include <vcc/queue.h>
 
@@ -24,9 +31,11 @@ namespace queue {
 queue_type get_device_queue(const type::supplier<const device::device_type> &device,
 		uint32_t queue_family_index, uint32_t queue_index) {
 	VkQueue queue;
-	vkGetDeviceQueue(internal::get_instance(*device), queue_family_index,
+	vkGetDeviceQueue(vcc::internal::get_instance(*device), queue_family_index,
 		queue_index, &queue);
-	return queue_type(queue, device, queue_family_index);
+	return queue_type(queue, device, queue_family_index,
+		std::make_shared<internal::prologue_type>(device, queue_family_index),
+		std::make_shared<internal::transient_type>(device, queue_family_index));
 }
 
 queue_type get_queue(const type::supplier<const device::device_type> &device, VkQueueFlags flags) {
@@ -83,78 +92,334 @@ std::pair<queue_type, queue_type> get_graphics_and_present_queues(
 		get_device_queue(device, (uint32_t) present_index, 0));
 }
 
-void submit(const queue_type &queue,
-		const std::vector<wait_semaphore> &wait_semaphores,
-		const std::vector<std::reference_wrapper<const command_buffer::command_buffer_type>>
-			&command_buffers,
-		const std::vector<std::reference_wrapper<const semaphore::semaphore_type>> &signal_semaphores,
+namespace {
+
+// Inline storage for N elements, allocated on the heap only beyond that.
+template<typename T, std::size_t N>
+class small_buffer_type {
+public:
+	explicit small_buffer_type(std::size_t size)
+		: heap(size > N ? new T[size] : nullptr), pointer(heap ? heap.get() : inline_data),
+		  count(size) {}
+	small_buffer_type(const small_buffer_type &) = delete;
+	small_buffer_type &operator=(const small_buffer_type &) = delete;
+
+	T &operator[](std::size_t index) {
+		return pointer[index];
+	}
+	T *data() {
+		return pointer;
+	}
+	T *begin() {
+		return pointer;
+	}
+	T *end() {
+		return pointer + count;
+	}
+	std::size_t size() const {
+		return count;
+	}
+
+private:
+	T inline_data[N];
+	std::unique_ptr<T[]> heap;
+	T *pointer;
+	std::size_t count;
+};
+
+// The arguments of one batch, pointing into the arguments of submit.
+struct batch_type {
+	const std::vector<wait_semaphore> *wait_semaphores;
+	const std::vector<std::reference_wrapper<const command_buffer::command_buffer_type>>
+		*command_buffers;
+	const std::vector<std::reference_wrapper<const semaphore::semaphore_type>>
+		*signal_semaphores;
+};
+
+// Holds the given mutexes, locked in order of address so that any number
+// can be taken without deadlocking. A mutex given twice is locked once,
+// a semaphore may be signaled by one batch and waited for by the next.
+class ordered_lock_type {
+public:
+	ordered_lock_type(std::mutex **first, std::mutex **last) : first(first), last(first) {
+		std::sort(first, last, std::less<std::mutex *>());
+		last = std::unique(first, last);
+		try {
+			for (; this->last != last; ++this->last) {
+				(*this->last)->lock();
+			}
+		} catch (...) {
+			unlock();
+			throw;
+		}
+	}
+	ordered_lock_type(const ordered_lock_type &) = delete;
+	ordered_lock_type &operator=(const ordered_lock_type &) = delete;
+	~ordered_lock_type() {
+		unlock();
+	}
+
+private:
+	void unlock() {
+		for (std::mutex **it = first; it != last; ++it) {
+			(*it)->unlock();
+		}
+	}
+
+	std::mutex **first, **last;
+};
+
+// Submits all batches with a single vkQueueSubmit, building the Vulkan
+// structures in inline storage for the common small submits.
+void submit(const queue_type &queue, const batch_type *batches, std::size_t batch_count,
 		const fence::fence_type *fence) {
-	std::vector<VkCommandBuffer> converted_command_buffers;
-	converted_command_buffers.reserve(command_buffers.size());
-	for (const command_buffer::command_buffer_type &command_buffer : command_buffers) {
-		converted_command_buffers.push_back(internal::get_instance(command_buffer));
-		command_buffer::internal::get_pre_execute_hook(command_buffer)(queue);
-	}
-	std::vector<VkSemaphore> converted_wait_semaphores;
-	converted_wait_semaphores.reserve(wait_semaphores.size());
-	std::vector<VkPipelineStageFlags> wait_mask;
-	wait_mask.reserve(wait_semaphores.size());
-	for (const wait_semaphore &semaphore : wait_semaphores) {
-		converted_wait_semaphores.push_back(internal::get_instance(*semaphore.semaphore));
-		wait_mask.push_back(semaphore.wait_dst_stage_mask);
-	}
-	std::vector<VkSemaphore> converted_signal_semaphores;
-	converted_signal_semaphores.reserve(signal_semaphores.size());
-	for (const semaphore::semaphore_type &semaphore : signal_semaphores) {
-		converted_signal_semaphores.push_back(internal::get_instance(semaphore));
-	}
-	VkSubmitInfo submit = { VK_STRUCTURE_TYPE_SUBMIT_INFO, NULL };
-	submit.waitSemaphoreCount = (uint32_t)converted_wait_semaphores.size();
-	submit.pWaitSemaphores = converted_wait_semaphores.empty() ? NULL : &converted_wait_semaphores.front();
-	submit.pWaitDstStageMask = wait_mask.empty() ? NULL : wait_mask.data();
-	submit.commandBufferCount = (uint32_t)converted_command_buffers.size();
-	submit.pCommandBuffers = converted_command_buffers.data();
-	submit.signalSemaphoreCount = (uint32_t)converted_signal_semaphores.size();
-	submit.pSignalSemaphores = converted_signal_semaphores.empty() ? NULL : &converted_signal_semaphores.front();
-	std::vector<std::unique_lock<std::mutex>> locks;
-	locks.reserve(wait_semaphores.size() + signal_semaphores.size());
-	for (const wait_semaphore &semaphore : wait_semaphores) {
-		locks.emplace_back(internal::get_mutex(*semaphore.semaphore), std::defer_lock);
-	}
-	for (const semaphore::semaphore_type &semaphore : signal_semaphores) {
-		locks.emplace_back(internal::get_mutex(semaphore), std::defer_lock);
-	}
-	util::lock(locks);
+	std::size_t wait_count(0), command_buffer_count(0), signal_count(0);
+	for (std::size_t i = 0; i < batch_count; ++i) {
+		wait_count += batches[i].wait_semaphores->size();
+		command_buffer_count += batches[i].command_buffers->size();
+		signal_count += batches[i].signal_semaphores->size();
+	}
+	// One more command buffer and batch for the prologue.
+	small_buffer_type<VkSemaphore, 8> converted_wait_semaphores(wait_count);
+	small_buffer_type<VkPipelineStageFlags, 8> wait_mask(wait_count);
+	small_buffer_type<VkCommandBuffer, 16> converted_command_buffers(command_buffer_count + 1);
+	small_buffer_type<VkSemaphore, 8> converted_signal_semaphores(signal_count);
+	small_buffer_type<VkSubmitInfo, 4> submits(batch_count + 1);
+	small_buffer_type<std::mutex *, 16> mutexes(wait_count + signal_count + 2);
+
+	// A target used by several of the command buffers is prepared once.
+	vcc::internal::object_key_set_type called;
+	// The hooks check whether their input buffers are dirty, collected once for all.
+	const type::internal::collect_batch_type collect_batch;
+	// Slot 0 is left for the prologue, executed first within the first batch.
+	std::size_t wait_index(0), command_buffer_index(1), signal_index(0), mutex_count(0);
+	for (std::size_t i = 0; i < batch_count; ++i) {
+		VkSubmitInfo &submit(submits[i + 1]);
+		submit = VkSubmitInfo{ VK_STRUCTURE_TYPE_SUBMIT_INFO, NULL };
+		submit.waitSemaphoreCount = (uint32_t) batches[i].wait_semaphores->size();
+		submit.pWaitSemaphores = converted_wait_semaphores.data() + wait_index;
+		submit.pWaitDstStageMask = wait_mask.data() + wait_index;
+		for (const wait_semaphore &semaphore : *batches[i].wait_semaphores) {
+			converted_wait_semaphores[wait_index] =
+				vcc::internal::get_instance(*semaphore.semaphore);
+			wait_mask[wait_index++] = semaphore.wait_dst_stage_mask;
+			mutexes[mutex_count++] = &vcc::internal::get_mutex(*semaphore.semaphore);
+		}
+		submit.commandBufferCount = (uint32_t) batches[i].command_buffers->size();
+		submit.pCommandBuffers = converted_command_buffers.data() + command_buffer_index;
+		for (const command_buffer::command_buffer_type &command_buffer
+				: *batches[i].command_buffers) {
+			converted_command_buffers[command_buffer_index++] =
+				vcc::internal::get_instance(command_buffer);
+			command_buffer::internal::get_pre_execute_hook(command_buffer)(called, queue);
+		}
+		submit.signalSemaphoreCount = (uint32_t) batches[i].signal_semaphores->size();
+		submit.pSignalSemaphores = converted_signal_semaphores.data() + signal_index;
+		for (const semaphore::semaphore_type &semaphore : *batches[i].signal_semaphores) {
+			converted_signal_semaphores[signal_index++] = vcc::internal::get_instance(semaphore);
+			mutexes[mutex_count++] = &vcc::internal::get_mutex(semaphore);
+		}
+	}
+	mutexes[mutex_count++] = &vcc::internal::get_mutex(queue);
 	if (fence) {
-		std::lock(internal::get_mutex(queue), internal::get_mutex(*fence));
-		std::lock_guard<std::mutex> queue_lock(internal::get_mutex(queue), std::adopt_lock);
-		std::lock_guard<std::mutex> fence_lock(internal::get_mutex(*fence), std::adopt_lock);
-		VKCHECK(vkQueueSubmit(internal::get_instance(queue), 1, &submit,
-			internal::get_instance(*fence)));
-	} else {
-		std::lock_guard<std::mutex> queue_lock(internal::get_mutex(queue));
-		VKCHECK(vkQueueSubmit(internal::get_instance(queue), 1, &submit, VK_NULL_HANDLE));
+		mutexes[mutex_count++] = &vcc::internal::get_mutex(*fence);
+	}
+	ordered_lock_type lock(mutexes.begin(), mutexes.begin() + mutex_count);
+
+	internal::prologue_type &prologue(*internal::get_prologue(queue));
+	VkFence prologue_fence;
+	converted_command_buffers[0] = prologue.record(&prologue_fence);
+	const VkCommandBuffer prologue_command_buffer(converted_command_buffers[0]);
+	VkSubmitInfo *first_submit(submits.data() + 1);
+	uint32_t submit_count((uint32_t) batch_count);
+	if (prologue_command_buffer && fence) {
+		// The fence of the caller must not be signaled early, so the prologue
+		// gets its own submit. It still executes first, in submission order.
+		VkSubmitInfo prologue_submit = { VK_STRUCTURE_TYPE_SUBMIT_INFO, NULL };
+		prologue_submit.commandBufferCount = 1;
+		prologue_submit.pCommandBuffers = &prologue_command_buffer;
+		try {
+			VKCHECK(vkQueueSubmit(vcc::internal::get_instance(queue), 1, &prologue_submit,
+				prologue_fence));
+		} catch (...) {
+			prologue.failed();
+			throw;
+		}
+		prologue.submitted();
+	} else if (prologue_command_buffer && batch_count) {
+		--submits[1].pCommandBuffers;
+		++submits[1].commandBufferCount;
+	} else if (prologue_command_buffer) {
+		submits[0] = VkSubmitInfo{ VK_STRUCTURE_TYPE_SUBMIT_INFO, NULL };
+		submits[0].commandBufferCount = 1;
+		submits[0].pCommandBuffers = converted_command_buffers.data();
+		--first_submit;
+		++submit_count;
+	}
+	try {
+		VKCHECK(vkQueueSubmit(vcc::internal::get_instance(queue), submit_count, first_submit,
+			fence ? VkFence(vcc::internal::get_instance(*fence))
+				: prologue_command_buffer ? prologue_fence : VK_NULL_HANDLE));
+	} catch (...) {
+		if (prologue_command_buffer && !fence) {
+			prologue.failed();
+		}
+		throw;
+	}
+	if (prologue_command_buffer && !fence) {
+		prologue.submitted();
 	}
 }
 
+}  // anonymous namespace
+
+void submit(const queue_type &queue, const std::vector<submit_info_type> &submits,
+		const fence::fence_type &fence) {
+	small_buffer_type<batch_type, 4> batches(submits.size());
+	for (std::size_t i = 0; i < submits.size(); ++i) {
+		batches[i] = batch_type{ &submits[i].wait_semaphores, &submits[i].command_buffers,
+			&submits[i].signal_semaphores };
+	}
+	submit(queue, batches.data(), batches.size(), &fence);
+}
+
+void submit(const queue_type &queue, const std::vector<submit_info_type> &submits) {
+	small_buffer_type<batch_type, 4> batches(submits.size());
+	for (std::size_t i = 0; i < submits.size(); ++i) {
+		batches[i] = batch_type{ &submits[i].wait_semaphores, &submits[i].command_buffers,
+			&submits[i].signal_semaphores };
+	}
+	submit(queue, batches.data(), batches.size(), nullptr);
+}
+
 void submit(const queue_type &queue,
 		const std::vector<wait_semaphore> &wait_semaphores,
 		const std::vector<std::reference_wrapper<const command_buffer::command_buffer_type>>
 			&command_buffers,
 		const std::vector<std::reference_wrapper<const semaphore::semaphore_type>> &signal_semaphores,
 		const fence::fence_type &fence) {
-	submit(queue, wait_semaphores, command_buffers, signal_semaphores, &fence);
+	const batch_type batch = { &wait_semaphores, &command_buffers, &signal_semaphores };
+	submit(queue, &batch, 1, &fence);
 }
 
 void submit(const queue_type &queue,
 	const std::vector<wait_semaphore> &wait_semaphores,
 	const std::vector<std::reference_wrapper<const command_buffer::command_buffer_type>> &command_buffers,
 	const std::vector<std::reference_wrapper<const semaphore::semaphore_type>> &signal_semaphores) {
-	submit(queue, wait_semaphores, command_buffers, signal_semaphores, nullptr);
+	const batch_type batch = { &wait_semaphores, &command_buffers, &signal_semaphores };
+	submit(queue, &batch, 1, nullptr);
+}
+
+namespace {
+
+VkSparseMemoryBind convert(const sparse_memory_bind_type &bind) {
+	return VkSparseMemoryBind{ bind.resource_offset, bind.size,
+		VkDeviceMemory(bind.memory ? vcc::internal::get_instance(*bind.memory) : VK_NULL_HANDLE),
+		bind.memory ? vcc::internal::get_offset(*bind.memory) + bind.memory_offset : 0,
+		bind.flags };
+}
+
+VkSparseImageMemoryBind convert(const sparse_image_memory_bind_type &bind) {
+	return VkSparseImageMemoryBind{ bind.subresource, bind.offset, bind.extent,
+		VkDeviceMemory(bind.memory ? vcc::internal::get_instance(*bind.memory) : VK_NULL_HANDLE),
+		bind.memory ? vcc::internal::get_offset(*bind.memory) + bind.memory_offset : 0,
+		bind.flags };
+}
+
+}  // anonymous namespace
+
+void bind_sparse(const queue_type &queue, const bind_sparse_info_type &info,
+		const fence::fence_type *fence) {
+	std::vector<VkSemaphore> wait_semaphores, signal_semaphores;
+	wait_semaphores.reserve(info.wait_semaphores.size());
+	signal_semaphores.reserve(info.signal_semaphores.size());
+	// An image may be in both the opaque and the image binds, ordered_lock_type
+	// locks its mutex once.
+	std::vector<std::mutex *> mutexes;
+	mutexes.push_back(&vcc::internal::get_mutex(queue));
+	if (fence) {
+		mutexes.push_back(&vcc::internal::get_mutex(*fence));
+	}
+	for (const semaphore::semaphore_type &semaphore : info.wait_semaphores) {
+		wait_semaphores.push_back(vcc::internal::get_instance(semaphore));
+		mutexes.push_back(&vcc::internal::get_mutex(semaphore));
+	}
+	for (const semaphore::semaphore_type &semaphore : info.signal_semaphores) {
+		signal_semaphores.push_back(vcc::internal::get_instance(semaphore));
+		mutexes.push_back(&vcc::internal::get_mutex(semaphore));
+	}
+	// Converted binds are kept per resource, the bind infos point into them.
+	std::vector<std::vector<VkSparseMemoryBind>> buffer_memory_binds, image_opaque_memory_binds;
+	std::vector<std::vector<VkSparseImageMemoryBind>> image_memory_binds;
+	std::vector<VkSparseBufferMemoryBindInfo> buffer_binds;
+	std::vector<VkSparseImageOpaqueMemoryBindInfo> image_opaque_binds;
+	std::vector<VkSparseImageMemoryBindInfo> image_binds;
+	buffer_memory_binds.reserve(info.buffer_binds.size());
+	buffer_binds.reserve(info.buffer_binds.size());
+	for (const sparse_buffer_bind_type &bind : info.buffer_binds) {
+		buffer_memory_binds.emplace_back();
+		buffer_memory_binds.back().reserve(bind.binds.size());
+		for (const sparse_memory_bind_type &memory_bind : bind.binds) {
+			buffer_memory_binds.back().push_back(convert(memory_bind));
+		}
+		buffer_binds.push_back(VkSparseBufferMemoryBindInfo{
+			vcc::internal::get_instance(bind.buffer.get()),
+			(uint32_t)bind.binds.size(), buffer_memory_binds.back().data() });
+		mutexes.push_back(&vcc::internal::get_mutex(bind.buffer.get()));
+	}
+	image_opaque_memory_binds.reserve(info.image_opaque_binds.size());
+	image_opaque_binds.reserve(info.image_opaque_binds.size());
+	for (const sparse_image_opaque_bind_type &bind : info.image_opaque_binds) {
+		image_opaque_memory_binds.emplace_back();
+		image_opaque_memory_binds.back().reserve(bind.binds.size());
+		for (const sparse_memory_bind_type &memory_bind : bind.binds) {
+			image_opaque_memory_binds.back().push_back(convert(memory_bind));
+		}
+		image_opaque_binds.push_back(VkSparseImageOpaqueMemoryBindInfo{
+			vcc::internal::get_instance(bind.image.get()),
+			(uint32_t)bind.binds.size(), image_opaque_memory_binds.back().data() });
+		mutexes.push_back(&vcc::internal::get_mutex(bind.image.get()));
+	}
+	image_memory_binds.reserve(info.image_binds.size());
+	image_binds.reserve(info.image_binds.size());
+	for (const sparse_image_bind_type &bind : info.image_binds) {
+		image_memory_binds.emplace_back();
+		image_memory_binds.back().reserve(bind.binds.size());
+		for (const sparse_image_memory_bind_type &memory_bind : bind.binds) {
+			image_memory_binds.back().push_back(convert(memory_bind));
+		}
+		image_binds.push_back(VkSparseImageMemoryBindInfo{
+			vcc::internal::get_instance(bind.image.get()),
+			(uint32_t)bind.binds.size(), image_memory_binds.back().data() });
+		mutexes.push_back(&vcc::internal::get_mutex(bind.image.get()));
+	}
+	VkBindSparseInfo bind = { VK_STRUCTURE_TYPE_BIND_SPARSE_INFO, NULL };
+	bind.waitSemaphoreCount = (uint32_t)wait_semaphores.size();
+	bind.pWaitSemaphores = wait_semaphores.empty() ? NULL : wait_semaphores.data();
+	bind.bufferBindCount = (uint32_t)buffer_binds.size();
+	bind.pBufferBinds = buffer_binds.empty() ? NULL : buffer_binds.data();
+	bind.imageOpaqueBindCount = (uint32_t)image_opaque_binds.size();
+	bind.pImageOpaqueBinds = image_opaque_binds.empty() ? NULL : image_opaque_binds.data();
+	bind.imageBindCount = (uint32_t)image_binds.size();
+	bind.pImageBinds = image_binds.empty() ? NULL : image_binds.data();
+	bind.signalSemaphoreCount = (uint32_t)signal_semaphores.size();
+	bind.pSignalSemaphores = signal_semaphores.empty() ? NULL : signal_semaphores.data();
+	ordered_lock_type lock(mutexes.data(), mutexes.data() + mutexes.size());
+	VKCHECK(vkQueueBindSparse(vcc::internal::get_instance(queue), 1, &bind,
+		fence ? VkFence(vcc::internal::get_instance(*fence)) : VkFence(VK_NULL_HANDLE)));
+}
+
+void bind_sparse(const queue_type &queue, const bind_sparse_info_type &info,
+		const fence::fence_type &fence) {
+	bind_sparse(queue, info, &fence);
+}
+
+void bind_sparse(const queue_type &queue, const bind_sparse_info_type &info) {
+	bind_sparse(queue, info, nullptr);
 }
 
 void wait_idle(const queue_type &queue) {
-	VKCHECK(vkQueueWaitIdle(internal::get_instance(queue)));
+	VKCHECK(vkQueueWaitIdle(vcc::internal::get_instance(queue)));
 }
 
 VkResult present(const queue_type &queue,
@@ -163,28 +428,28 @@ VkResult present(const queue_type &queue,
 		const std::vector<uint32_t> &image_indices) {
 	VkPresentInfoKHR info = {VK_STRUCTURE_TYPE_PRESENT_INFO_KHR, NULL};
 	info.waitSemaphoreCount = (uint32_t) semaphores.size();
-	std::vector<std::unique_lock<std::mutex>> locks;
-	locks.reserve(1 + semaphores.size() + swapchains.size());
-	locks.emplace_back(internal::get_mutex(queue), std::defer_lock);
+	std::vector<std::mutex *> mutexes;
+	mutexes.reserve(1 + semaphores.size() + swapchains.size());
+	mutexes.push_back(&vcc::internal::get_mutex(queue));
 	std::vector<VkSemaphore> converted_semaphores;
 	converted_semaphores.reserve(semaphores.size());
 	for (const semaphore::semaphore_type &semaphore : semaphores) {
-		converted_semaphores.push_back(internal::get_instance(semaphore));
-		locks.emplace_back(internal::get_mutex(semaphore), std::defer_lock);
+		converted_semaphores.push_back(vcc::internal::get_instance(semaphore));
+		mutexes.push_back(&vcc::internal::get_mutex(semaphore));
 	}
 	info.pWaitSemaphores = semaphores.empty() ? NULL : &converted_semaphores.front();
 	info.swapchainCount = (uint32_t) swapchains.size();
 	std::vector<VkSwapchainKHR> converted_swapchains;
 	converted_swapchains.reserve(swapchains.size());
 	for (const swapchain::swapchain_type &swapchain : swapchains) {
-		converted_swapchains.push_back(internal::get_instance(swapchain));
-		locks.emplace_back(internal::get_mutex(swapchain), std::defer_lock);
+		converted_swapchains.push_back(vcc::internal::get_instance(swapchain));
+		mutexes.push_back(&vcc::internal::get_mutex(swapchain));
 	}
 	info.pSwapchains = swapchains.empty() ? NULL : &converted_swapchains.front();
 	info.pImageIndices = image_indices.empty() ? NULL : &image_indices.front();
 	info.pResults = NULL;
-	util::lock(locks);
-	return vkQueuePresentKHR(internal::get_instance(queue), &info);
+	ordered_lock_type lock(mutexes.data(), mutexes.data() + mutexes.size());
+	return vkQueuePresentKHR(vcc::internal::get_instance(queue), &info);
 }
 
 }  // namespace queue
@@ -0,0 +1,74 @@
+/*
+* Copyright 2016 Google Inc. All Rights Reserved.
+
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+
+* http://www.apache.org/licenses/LICENSE-2.0
+
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#define NOMINMAX
+#include <algorithm>
+#include <vcc/memory.h>
+#include <vcc/physical_device.h>
+#include <vcc/ring_buffer.h>
+
+namespace vcc {
+namespace ring_buffer {
+
+ring_buffer_type create(const type::supplier<const device::device_type> &device,
+		VkDeviceSize frame_size, uint32_t frames, VkBufferUsageFlags usage) {
+	const VkPhysicalDeviceLimits limits(physical_device::properties(
+		device::get_physical_device(*device)).limits);
+	VkDeviceSize alignment(1);
+	if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) {
+		alignment = std::max(alignment, limits.minUniformBufferOffsetAlignment);
+	}
+	if (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) {
+		alignment = std::max(alignment, limits.minStorageBufferOffsetAlignment);
+	}
+	ring_buffer_type ring;
+	ring.alignment = alignment;
+	ring.frame_size = (frame_size + alignment - 1) / alignment * alignment;
+	ring.fences.resize(frames);
+	ring.buffer = buffer::create(device, 0, ring.frame_size * frames, usage,
+		VK_SHARING_MODE_EXCLUSIVE, {});
+	memory::bind(device, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, ring.buffer);
+	memory::map_type map(memory::map(internal::get_memory(ring.buffer),
+		internal::get_offset(ring.buffer), ring.frame_size * frames));
+	ring.data = map.data;
+	// The memory stays mapped, slices are flushed by next_frame.
+	memory::release(map);
+	return ring;
+}
+
+void next_frame(ring_buffer_type &ring, const type::supplier<const fence::fence_type> &fence,
+		std::chrono::nanoseconds timeout) {
+	const memory::memory_type &memory(*internal::get_memory(ring.buffer));
+	const VkDeviceSize used(std::min(ring.head.load(), ring.frame_size));
+	if (used && !(memory::get_property_flags(memory) & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+		memory::flush(memory, internal::get_offset(ring.buffer) + ring.frame * ring.frame_size,
+			used);
+	}
+	const uint32_t next((ring.frame + 1) % uint32_t(ring.fences.size()));
+	// With a single region the frame just ended is the one to wait for.
+	const type::supplier<const fence::fence_type> &in_flight(
+		next == ring.frame ? fence : ring.fences[next]);
+	if (in_flight && fence::wait(*internal::get_parent(ring.buffer), { *in_flight }, true,
+			timeout) == VK_TIMEOUT) {
+		throw vcc_exception("ring_buffer frame is still in flight");
+	}
+	ring.fences[ring.frame] = fence;
+	ring.fences[next] = type::supplier<const fence::fence_type>();
+	ring.frame = next;
+	ring.head = 0;
+}
+
+}  // namespace ring_buffer
+}  // namespace vcc
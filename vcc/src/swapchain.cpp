@@ -63,7 +63,8 @@ swapchain_type create(const type::supplier<const device::device_type> &device,
 				NULL, &swapchain));
 		}
 	}
-	return swapchain_type(swapchain, device, create_info.imageFormat);
+	return swapchain_type(swapchain, device, create_info.imageFormat,
+		create_info.imageExtent);
 }
 
 std::vector<image::image_type> get_images(swapchain_type &swapchain) {
@@ -75,8 +76,9 @@ std::vector<image::image_type> get_images(swapchain_type &swapchain) {
 	VKCHECK(vkGetSwapchainImagesKHR(internal::get_instance(*internal::get_parent(swapchain)), internal::get_instance(swapchain), &count, &images.front()));
 	std::vector<image::image_type> converted_images;
 	converted_images.reserve(images.size());
+	const VkExtent2D &extent(get_extent(swapchain));
 	for (VkImage image : images) {
-		converted_images.push_back(image::image_type(image, internal::get_parent(swapchain), false, VK_IMAGE_TYPE_2D, get_format(swapchain), 1, 1));
+		converted_images.push_back(image::image_type(image, internal::get_parent(swapchain), false, 0, VK_IMAGE_TYPE_2D, get_format(swapchain), VkExtent3D{ extent.width, extent.height, 1 }, 1, 1, VK_IMAGE_TILING_OPTIMAL));
 	}
 	return std::move(converted_images);
 }
@@ -0,0 +1,93 @@
+/*
+* Copyright 2016 Google Inc. All Rights Reserved.
+
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+
+* http://www.apache.org/licenses/LICENSE-2.0
+
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include <vcc/internal/transient.h>
+#include <vcc/queue.h>
+
+namespace vcc {
+namespace queue {
+namespace internal {
+
+transient_type::~transient_type() {
+	std::vector<std::reference_wrapper<const fence::fence_type>> fences;
+	for (const std::unique_ptr<frame_type> &frame : frames) {
+		if (frame->submitted) {
+			fences.push_back(std::cref(frame->fence));
+		}
+	}
+	if (!fences.empty()) {
+		fence::wait(*device, fences, true);
+	}
+}
+
+std::unique_ptr<transient_type::frame_type> transient_type::acquire() {
+	std::unique_ptr<frame_type> frame;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto it(frames.begin()); it != frames.end(); ++it) {
+			if (!(*it)->submitted || vkGetFenceStatus(vcc::internal::get_instance(*device),
+					vcc::internal::get_instance((*it)->fence)) == VK_SUCCESS) {
+				frame = std::move(*it);
+				frames.erase(it);
+				break;
+			}
+		}
+	}
+	if (frame) {
+		if (frame->submitted) {
+			fence::reset(*device, { frame->fence });
+			frame->submitted = false;
+		}
+		// Returns the command buffer to the initial state along with the memory it used.
+		std::lock_guard<std::mutex> pool_lock(vcc::internal::get_mutex(*frame->command_pool));
+		VKCHECK(vkResetCommandPool(vcc::internal::get_instance(*device),
+			vcc::internal::get_instance(*frame->command_pool), 0));
+	} else {
+		frame.reset(new frame_type());
+		frame->command_pool = std::make_shared<command_pool::command_pool_type>(
+			command_pool::create(device, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, family_index));
+		frame->command_buffer = std::move(command_buffer::allocate(device,
+			frame->command_pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1).front());
+		frame->fence = fence::create(device);
+		frame->submitted = false;
+	}
+	return frame;
+}
+
+void transient_type::release(std::unique_ptr<frame_type> &&frame) {
+	std::lock_guard<std::mutex> lock(mutex);
+	frames.push_back(std::move(frame));
+}
+
+void execute(const queue_type &queue,
+		const std::function<void(command_buffer::command_buffer_type &)> &record) {
+	transient_type &transient(*get_transient(queue));
+	std::unique_ptr<transient_type::frame_type> frame(transient.acquire());
+	try {
+		record(frame->command_buffer);
+		submit(queue, {}, { frame->command_buffer }, {}, frame->fence);
+	} catch (...) {
+		transient.release(std::move(frame));
+		throw;
+	}
+	frame->submitted = true;
+	const device::device_type &device(*vcc::internal::get_parent(queue));
+	fence::wait(device, { frame->fence }, true);
+	transient.release(std::move(frame));
+}
+
+}  // namespace internal
+}  // namespace queue
+}  // namespace vcc